@@ -137,7 +137,7 @@ void Buffer::MakeSpace(size_t len) {
     if (WritableBytes() + PrependableBytes() < len) {
         /*如果prepend区和writable区的总空间也不足够，则需要为缓冲区
     resize空间，以实现自动增长。Buffer的空间增长之后，不会再回缩*/
-        m_buffer.resize(m_writeIdx + len - 1);
+        m_buffer.resize(m_writeIdx + len + 1);
     } else {
         /*如果prepend区和writable区的总空间足够写入数据，
         则可先将readable区的数据腾挪到前面，以腾出空间*/
@@ -0,0 +1,163 @@
+#include "asset_pack.h"
+#include "../log/log.h"
+#include "../utils/str_hash.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+AssetPack::AssetPack() : m_size(0), m_header(nullptr), m_entries(nullptr), m_slots(nullptr) {}
+
+AssetPack *AssetPack::Instance() {
+    static AssetPack pack;
+    return &pack;
+}
+
+bool AssetPack::Open(const std::string &file, const std::string &root, bool populate, bool hugePages) {
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR("Asset pack %s open error:%s", file.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(PackHeader)) {
+        LOG_ERROR("Asset pack %s is too small!", file.c_str());
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | (populate ? MAP_POPULATE : 0), fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        LOG_ERROR("Asset pack %s mmap error:%s", file.c_str(), strerror(errno));
+        return false;
+    }
+    std::shared_ptr<const char> base(static_cast<const char *>(addr),
+                                     [size](const char *p) { munmap(const_cast<char *>(p), size); });
+    if (hugePages) {
+        /*文件映射的页缓存一般不能使用大页，复制到按2MB对齐的匿名内存中再建议内核合并为透明大页*/
+        const size_t HUGE_PAGE = 2 * 1024 * 1024;
+        size_t len = (size + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+        void *anon = mmap(nullptr, len + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (anon == MAP_FAILED) {
+            LOG_WARN("Asset pack hugepage copy failed, keep the file mapping");
+        } else {
+            char *aligned = reinterpret_cast<char *>(
+                (reinterpret_cast<uintptr_t>(anon) + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE);
+            if (madvise(aligned, len, MADV_HUGEPAGE) < 0) {
+                LOG_WARN("Asset pack madvise(MADV_HUGEPAGE) error:%s", strerror(errno));
+            }
+            memcpy(aligned, base.get(), size);
+            mprotect(aligned, len, PROT_READ);
+            base = std::shared_ptr<const char>(aligned,
+                                               [anon, len, HUGE_PAGE](const char *) { munmap(anon, len + HUGE_PAGE); });
+        }
+    }
+    m_base = base;
+    m_size = size;
+    m_header = reinterpret_cast<const PackHeader *>(m_base.get());
+    m_entries = reinterpret_cast<const PackEntry *>(m_base.get() + sizeof(PackHeader));
+    m_slots = reinterpret_cast<const uint32_t *>(m_entries + m_header->count);
+    m_root = root;
+    if (!Validate()) {
+        LOG_ERROR("Asset pack %s is corrupt or of another version!", file.c_str());
+        m_base.reset();
+        m_header = nullptr;
+        m_size = 0;
+        return false;
+    }
+    return true;
+}
+
+bool AssetPack::Validate() const {
+    const PackHeader &h = *m_header;
+    if (memcmp(h.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 || h.version != PACK_VERSION || h.fileSize != m_size) {
+        return false;
+    }
+    if (h.slots == 0 || (h.slots & (h.slots - 1)) != 0 || h.slots <= h.count) {
+        return false;
+    }
+    size_t tableEnd = sizeof(PackHeader) + h.count * sizeof(PackEntry) + h.slots * sizeof(uint32_t);
+    if (tableEnd > m_size) {
+        return false;
+    }
+    for (uint32_t i = 0; i < h.count; i++) {
+        const PackEntry &e = m_entries[i];
+        if (e.pathOffset > m_size || e.pathLen > m_size - e.pathOffset || e.dataOffset > m_size ||
+            e.size > m_size - e.dataOffset || e.headerOffset > m_size ||
+            static_cast<uint64_t>(e.headerLen) + e.variantHeaderLen > m_size - e.headerOffset) {
+            return false;
+        }
+    }
+    /*Find遇到空槽位才停止查找，没有空槽位时不在包中的路径会一直探测下去*/
+    uint32_t empty = 0;
+    for (uint32_t i = 0; i < h.slots; i++) {
+        if (m_slots[i] > h.count) {
+            return false;
+        }
+        empty += m_slots[i] == 0;
+    }
+    return empty > 0;
+}
+
+const PackEntry *AssetPack::Find(const std::string &file) const {
+    if (!m_header || file.compare(0, m_root.size(), m_root) != 0) {
+        return nullptr;
+    }
+    /*包中的路径以'/'开头；srcDir以'/'结尾，文件路径在它之后不以'/'开头时借用它的'/'*/
+    size_t begin = m_root.size();
+    if (begin > 0 && (begin == file.size() || file[begin] != '/')) {
+        begin--;
+    }
+    const char *path = file.data() + begin;
+    size_t len = file.size() - begin;
+    uint32_t hash = StrHash(path, len);
+    uint32_t mask = m_header->slots - 1;
+    uint32_t i = hash & mask;
+    for (uint32_t n = 0; n < m_header->slots; n++, i = (i + 1) & mask) {
+        uint32_t slot = m_slots[i];
+        if (slot == 0) {
+            return nullptr;
+        }
+        const PackEntry &e = m_entries[slot - 1];
+        if (e.pathHash == hash && e.pathLen == len && memcmp(m_base.get() + e.pathOffset, path, len) == 0) {
+            return &e;
+        }
+    }
+    return nullptr;
+}
+
+bool AssetPack::Stat(const std::string &file, struct stat &st) const {
+    const PackEntry *e = Find(file);
+    if (!e) {
+        return false;
+    }
+    st = {0};
+    st.st_mode = S_IFREG | 0444;
+    st.st_nlink = 1;
+    st.st_ino = e->contentHash != 0 ? e->contentHash : 1; //st_ino为0表示没有找到预压缩文件
+    st.st_size = e->size;
+    st.st_mtim.tv_sec = e->mtimeSec;
+    st.st_mtim.tv_nsec = e->mtimeNsec;
+    return true;
+}
+
+std::shared_ptr<const char> AssetPack::Data(const std::string &file) const {
+    const PackEntry *e = Find(file);
+    if (!e) {
+        return nullptr;
+    }
+    return std::shared_ptr<const char>(m_base, m_base.get() + e->dataOffset);
+}
+
+const char *AssetPack::HeaderBlock(const std::string &file, bool variant, size_t &len) const {
+    const PackEntry *e = Find(file);
+    if (!e) {
+        return nullptr;
+    }
+    len = variant ? e->variantHeaderLen : e->headerLen;
+    if (len == 0) {
+        return nullptr;
+    }
+    return m_base.get() + e->headerOffset + (variant ? e->headerLen : 0);
+}
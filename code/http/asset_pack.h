@@ -0,0 +1,80 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+
+/*静态资源包：由tools/pack把resources目录打包成一个文件，启动时整个映射到内存
+ *文件布局：PackHeader | PackEntry[count] | uint32_t槽位[slots] | 路径字符串 | 实体头部 | 各文件内容(按64字节对齐)
+ *槽位是以路径的StrHash为键、线性探测的开放寻址哈希表，值为条目下标加1，0表示空，至少有一个空槽位；
+ *可压缩的文件另有".gz"/".br"条目，与目录中的预压缩文件一样参与协商；
+ *每个条目带有打包时生成的200响应的实体头部(见entity_headers.h)，预压缩条目另有一份作为原文件的编码发送时的头部*/
+struct PackHeader {
+    char magic[8]; //"WSPACK\0\0"
+    uint32_t version;
+    uint32_t count; //条目数
+    uint32_t slots; //哈希表槽位数，2的幂
+    uint32_t reserved;
+    uint64_t fileSize; //整个包的字节数，用于校验是否完整
+};
+
+struct PackEntry {
+    uint64_t pathOffset; //相对包开头
+    uint32_t pathLen;
+    uint32_t pathHash; //StrHash(路径)
+    uint64_t dataOffset;
+    uint64_t size;
+    uint64_t contentHash; //内容的FNV-1a哈希，作为inode参与ETag，同样的内容在不同机器、不同次部署中ETag不变
+    int64_t mtimeSec;     //打包时源文件的修改时间，用于Last-Modified
+    int64_t mtimeNsec;
+    uint64_t headerOffset;     //实体头部，直接请求该文件时使用
+    uint32_t headerLen;
+    uint32_t variantHeaderLen; //紧接在实体头部之后，作为原文件的Content-Encoding发送时使用；不是预压缩条目时为0
+};
+
+static const char PACK_MAGIC[8] = {'W', 'S', 'P', 'A', 'C', 'K', '\0', '\0'};
+static const uint32_t PACK_VERSION = 2;
+static const size_t PACK_ALIGN = 64;
+
+/*启用资源包后，HttpResponse的文件状态和内容都从包中取得，不再访问resources目录*/
+class AssetPack
+{
+public:
+    static AssetPack *Instance();
+    /*root为原资源目录(HttpConn::srcDir)，请求的文件路径去掉该前缀后在包中查找；
+     *populate时以MAP_POPULATE预先读入全部页，hugePages时复制到匿名内存并建议使用透明大页*/
+    bool Open(const std::string &file, const std::string &root, bool populate, bool hugePages);
+    bool Active() const {
+        return m_base != nullptr;
+    }
+    /*包中的文件的状态：st_ino为内容哈希，权限为只读；不存在时返回false*/
+    bool Stat(const std::string &file, struct stat &st) const;
+    /*文件内容，与整个包共享所有权；不存在时返回nullptr*/
+    std::shared_ptr<const char> Data(const std::string &file) const;
+    /*200响应的实体头部(ETag到Content-length)，variant表示作为原文件的预压缩版本发送；没有时返回nullptr*/
+    const char *HeaderBlock(const std::string &file, bool variant, size_t &len) const;
+    uint32_t Count() const {
+        return m_header ? m_header->count : 0;
+    }
+    size_t Bytes() const {
+        return m_size;
+    }
+
+private:
+    std::shared_ptr<const char> m_base;
+    size_t m_size;
+    const PackHeader *m_header;
+    const PackEntry *m_entries;
+    const uint32_t *m_slots;
+    std::string m_root;
+
+    AssetPack();
+    ~AssetPack() = default;
+    bool Validate() const;
+    const PackEntry *Find(const std::string &file) const;
+};
+
+#endif // !ASSET_PACK_H
@@ -0,0 +1,166 @@
+#include "compressor.h"
+#include "../log/log.h"
+#include <zlib.h>
+#ifndef NO_BROTLI
+#include <brotli/encode.h>
+#endif
+
+bool Compressor::Compress(Encoding encoding, const char *data, size_t len, std::string &out) {
+    switch (encoding) {
+        case GZIP:
+            return Gzip(data, len, out);
+        case BROTLI:
+            return Brotli(data, len, out);
+        default:
+            return false;
+    }
+}
+
+const char *Compressor::Name(Encoding encoding) {
+    switch (encoding) {
+        case GZIP:
+            return "gzip";
+        case BROTLI:
+            return "br";
+        default:
+            return "identity";
+    }
+}
+
+const char *Compressor::Suffix(Encoding encoding) {
+    switch (encoding) {
+        case GZIP:
+            return ".gz";
+        case BROTLI:
+            return ".br";
+        default:
+            return "";
+    }
+}
+
+bool Compressor::Supported(Encoding encoding) {
+#ifdef NO_BROTLI
+    return encoding == GZIP;
+#else
+    return encoding == GZIP || encoding == BROTLI;
+#endif
+}
+
+bool Compressor::Gzip(const char *data, size_t len, std::string &out) {
+    z_stream stream = {};
+    /*windowBits加16输出gzip格式而不是zlib格式*/
+    if (deflateInit2(&stream, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        LOG_ERROR("deflateInit2 error!");
+        return false;
+    }
+    out.resize(deflateBound(&stream, len));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    stream.avail_in = len;
+    stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    stream.avail_out = out.size();
+    int ret = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (ret != Z_STREAM_END) {
+        LOG_ERROR("deflate error:%d", ret);
+        return false;
+    }
+    out.resize(stream.total_out);
+    return true;
+}
+
+bool Compressor::Brotli(const char *data, size_t len, std::string &out) {
+#ifdef NO_BROTLI
+    return false;
+#else
+    size_t outLen = BrotliEncoderMaxCompressedSize(len);
+    if (outLen == 0) {
+        return false;
+    }
+    out.resize(outLen);
+    if (!BrotliEncoderCompress(BROTLI_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, len,
+                               reinterpret_cast<const uint8_t *>(data), &outLen,
+                               reinterpret_cast<uint8_t *>(&out[0]))) {
+        LOG_ERROR("BrotliEncoderCompress error!");
+        return false;
+    }
+    out.resize(outLen);
+    return true;
+#endif
+}
+
+Compressor::Stream::Stream(Encoding encoding) : m_encoding(encoding), m_zstream(nullptr), m_brotli(nullptr) {
+    if (encoding == GZIP) {
+        m_zstream = new z_stream();
+        if (deflateInit2(m_zstream, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            LOG_ERROR("deflateInit2 error!");
+            delete m_zstream;
+            m_zstream = nullptr;
+        }
+    }
+#ifndef NO_BROTLI
+    if (encoding == BROTLI) {
+        m_brotli = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+        if (m_brotli) {
+            BrotliEncoderSetParameter(m_brotli, BROTLI_PARAM_QUALITY, BROTLI_QUALITY);
+            BrotliEncoderSetParameter(m_brotli, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+        } else {
+            LOG_ERROR("BrotliEncoderCreateInstance error!");
+        }
+    }
+#endif
+}
+
+Compressor::Stream::~Stream() {
+    if (m_zstream) {
+        deflateEnd(m_zstream);
+        delete m_zstream;
+    }
+#ifndef NO_BROTLI
+    if (m_brotli) {
+        BrotliEncoderDestroyInstance(m_brotli);
+    }
+#endif
+}
+
+bool Compressor::Stream::Write(const char *data, size_t len, bool finish, std::string &out) {
+    const size_t STEP = 16 * 1024; //输出空间不足时每次扩展的字节数
+    if (m_zstream) {
+        m_zstream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        m_zstream->avail_in = len;
+        int ret;
+        do {
+            size_t used = out.size();
+            out.resize(used + STEP);
+            m_zstream->next_out = reinterpret_cast<Bytef *>(&out[used]);
+            m_zstream->avail_out = STEP;
+            ret = deflate(m_zstream, finish ? Z_FINISH : Z_NO_FLUSH);
+            out.resize(used + STEP - m_zstream->avail_out);
+            if (ret == Z_STREAM_ERROR) {
+                LOG_ERROR("deflate error:%d", ret);
+                return false;
+            }
+        } while (m_zstream->avail_out == 0 || (finish && ret != Z_STREAM_END));
+        return true;
+    }
+#ifndef NO_BROTLI
+    if (m_brotli) {
+        const uint8_t *next = reinterpret_cast<const uint8_t *>(data);
+        size_t avail = len;
+        BrotliEncoderOperation op = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+        while (avail > 0 || BrotliEncoderHasMoreOutput(m_brotli) || (finish && !BrotliEncoderIsFinished(m_brotli))) {
+            size_t used = out.size();
+            out.resize(used + STEP);
+            uint8_t *nextOut = reinterpret_cast<uint8_t *>(&out[used]);
+            size_t availOut = STEP;
+            if (!BrotliEncoderCompressStream(m_brotli, op, &avail, &next, &availOut, &nextOut, nullptr)) {
+                out.resize(used);
+                LOG_ERROR("BrotliEncoderCompressStream error!");
+                return false;
+            }
+            out.resize(used + STEP - availOut);
+        }
+        return true;
+    }
+#endif
+    return false;
+}
@@ -0,0 +1,55 @@
+#ifndef COMPRESSOR_H
+#define COMPRESSOR_H
+
+#include <cstddef>
+#include <string>
+
+struct z_stream_s;
+struct BrotliEncoderStateStruct;
+
+/*响应内容的压缩编码，用于没有预压缩文件时即时压缩
+ *以make NO_BROTLI=1编译时不支持brotli*/
+class Compressor
+{
+public:
+    enum Encoding {
+        IDENTITY = 0, //不压缩
+        GZIP,
+        BROTLI,
+    };
+
+    /*压缩失败时返回false*/
+    static bool Compress(Encoding encoding, const char *data, size_t len, std::string &out);
+    /*Content-Encoding中的名字*/
+    static const char *Name(Encoding encoding);
+    /*预压缩文件的后缀，如".gz"*/
+    static const char *Suffix(Encoding encoding);
+    static bool Supported(Encoding encoding);
+
+    /*流式压缩：分段输入，随时取出已产生的压缩数据，内存占用与输入总长无关；用于不缓存的大文件*/
+    class Stream
+    {
+    public:
+        explicit Stream(Encoding encoding);
+        ~Stream();
+        Stream(const Stream &) = delete;
+        Stream &operator=(const Stream &) = delete;
+        /*压缩[data, data + len)，产生的数据追加到out末尾；finish为true时结束压缩流，之后不能再调用*/
+        bool Write(const char *data, size_t len, bool finish, std::string &out);
+
+    private:
+        Encoding m_encoding;
+        z_stream_s *m_zstream;
+        BrotliEncoderStateStruct *m_brotli;
+    };
+
+private:
+    /*即时压缩在工作线程中进行，结果会被缓存，取压缩率和速度的折中；流式压缩使用同样的级别*/
+    static const int GZIP_LEVEL = 6;
+    static const int BROTLI_QUALITY = 5;
+
+    static bool Gzip(const char *data, size_t len, std::string &out);
+    static bool Brotli(const char *data, size_t len, std::string &out);
+};
+
+#endif // !COMPRESSOR_H
@@ -0,0 +1,104 @@
+#ifndef ENTITY_HEADERS_H
+#define ENTITY_HEADERS_H
+
+#include "../utils/str_hash.h"
+#include <cstdio>
+#include <ctime>
+#include <string>
+
+/*静态文件的实体头部(类型、ETag、修改时间等)只由文件本身决定
+ *HttpResponse和tools/pack共用这里的实现，资源包中预先生成的头部与服务器生成的逐字节相同*/
+
+/*哈希命中后还要比较字符串，不在表中的后缀可能与表中某项哈希相同*/
+#define SUFFIX_CASE(suffix, type)                                                                                      \
+    case StrHash(suffix):                                                                                              \
+        return StrEquals(str, len, suffix) ? type : nullptr
+
+/*文件后缀(如".css")对应的类型，查找表是switch，不分配内存；未知的后缀返回nullptr*/
+inline const char *SuffixType(const char *str, size_t len) {
+    switch (StrHash(str, len)) {
+        SUFFIX_CASE(".html", "text/html");
+        SUFFIX_CASE(".xml", "text/xml");
+        SUFFIX_CASE(".xhtml", "application/xhtml+xml");
+        SUFFIX_CASE(".txt", "text/plain");
+        SUFFIX_CASE(".rtf", "application/rtf");
+        SUFFIX_CASE(".pdf", "application/pdf");
+        SUFFIX_CASE(".word", "application/nsword");
+        SUFFIX_CASE(".png", "image/png");
+        SUFFIX_CASE(".gif", "image/gif");
+        SUFFIX_CASE(".jpg", "image/jpeg");
+        SUFFIX_CASE(".jpeg", "image/jpeg");
+        SUFFIX_CASE(".au", "audio/basic");
+        SUFFIX_CASE(".mpeg", "video/mpeg");
+        SUFFIX_CASE(".mpg", "video/mpeg");
+        SUFFIX_CASE(".avi", "video/x-msvideo");
+        SUFFIX_CASE(".gz", "application/x-gzip");
+        SUFFIX_CASE(".tar", "application/x-tar");
+        SUFFIX_CASE(".css", "text/css ");
+        SUFFIX_CASE(".js", "text/javascript ");
+        SUFFIX_CASE(".mp4", "video/mp4");
+        SUFFIX_CASE(".webm", "video/webm");
+        SUFFIX_CASE(".ogv", "video/ogg");
+        SUFFIX_CASE(".mp3", "audio/mpeg");
+        SUFFIX_CASE(".wav", "audio/wav");
+        default:
+            return nullptr;
+    }
+}
+
+#undef SUFFIX_CASE
+
+/*按路径的后缀取得文件类型，没有后缀或未知的后缀为text/plain*/
+inline const char *FileType(const std::string &path) {
+    std::string::size_type idx = path.find_last_of('.');
+    if (idx == std::string::npos) {
+        return "text/plain";
+    }
+    const char *type = SuffixType(path.data() + idx, path.size() - idx);
+    return type ? type : "text/plain";
+}
+
+/*文本类的文件值得压缩，图片、视频等已经压缩过的格式不压缩*/
+inline bool Compressible(const std::string &path) {
+    std::string type = FileType(path);
+    return type.compare(0, 5, "text/") == 0 || type.find("xml") != std::string::npos ||
+           type.find("json") != std::string::npos || type.find("javascript") != std::string::npos;
+}
+
+/*强ETag，由inode、大小和修改时间(纳秒)生成；suffix不为空时(即时压缩的内容)加上编码后缀*/
+inline std::string EntityTag(unsigned long ino, unsigned long size, unsigned long long mtimeNs, const char *suffix) {
+    char buf[80];
+    snprintf(buf, sizeof(buf), "\"%lx-%lx-%llx%s%s\"", ino, size, mtimeNs, *suffix ? "-" : "", suffix);
+    return buf;
+}
+
+inline std::string HttpDate(time_t t) {
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char buf[64];
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return buf;
+}
+
+/*200响应中描述文件内容的头部，从ETag到Content-length，不含Connection、Cache-Control和Date；
+ *Content-type按typePath取得，encoding不为nullptr时内容是typePath的预压缩文件*/
+inline std::string EntityHeaderBlock(const std::string &typePath, unsigned long ino, size_t size,
+                                     const struct timespec &mtime, bool vary, const char *encoding) {
+    std::string block = "ETag: " +
+                        EntityTag(ino, size, static_cast<unsigned long long>(mtime.tv_sec) * 1000000000ULL + mtime.tv_nsec,
+                                  "") +
+                        "\r\n";
+    block += "Last-Modified: " + HttpDate(mtime.tv_sec) + "\r\n";
+    if (vary) {
+        block += "Vary: Accept-Encoding\r\n";
+    }
+    if (encoding) {
+        block += std::string("Content-Encoding: ") + encoding + "\r\n";
+    }
+    block += "Accept-Ranges: bytes\r\n";
+    block += std::string("Content-type: ") + FileType(typePath) + "\r\n";
+    block += "Content-length: " + std::to_string(size) + "\r\n";
+    return block;
+}
+
+#endif // !ENTITY_HEADERS_H
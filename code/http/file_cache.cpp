@@ -0,0 +1,132 @@
+#include "file_cache.h"
+#include "../log/log.h"
+#include "../metrics/metrics.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+FileCache::FileCache(const char *name) : m_capacity(0), m_maxFileSize(0), m_bytes(0) {
+    NameLock(m_mutex, name);
+}
+
+FileCache *FileCache::Instance() {
+    static FileCache cache("file_cache");
+    return &cache;
+}
+
+FileCache *FileCache::Encoded() {
+    static FileCache cache("encoded_cache");
+    return &cache;
+}
+
+FileCache *FileCache::Headers() {
+    static FileCache cache("header_cache");
+    return &cache;
+}
+
+void FileCache::Init(size_t capacity, size_t maxFileSize) {
+    std::lock_guard<ServerMutex> locker(m_mutex);
+    m_capacity = capacity;
+    m_maxFileSize = maxFileSize;
+}
+
+bool FileCache::Matches(const Entry &entry, const struct stat &st) {
+    return entry.ino == st.st_ino && entry.size == st.st_size && entry.mtime.tv_sec == st.st_mtim.tv_sec &&
+           entry.mtime.tv_nsec == st.st_mtim.tv_nsec;
+}
+
+std::shared_ptr<const FileCache::Entry> FileCache::Load(const std::string &path, const struct stat &st) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    std::shared_ptr<Entry> entry(new Entry());
+    entry->data.resize(st.st_size);
+    size_t done = 0;
+    while (done < entry->data.size()) {
+        ssize_t len = read(fd, &entry->data[done], entry->data.size() - done);
+        if (len <= 0) {
+            break;
+        }
+        done += len;
+    }
+    close(fd);
+    if (done != entry->data.size()) {
+        LOG_WARN("FileCache load %s error, read %zu of %zu bytes", path.c_str(), done, entry->data.size());
+        return nullptr;
+    }
+    entry->ino = st.st_ino;
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtim;
+    return entry;
+}
+
+std::shared_ptr<const FileCache::Entry> FileCache::Get(const std::string &path, const struct stat &st, bool load) {
+    {
+        std::lock_guard<ServerMutex> locker(m_mutex);
+        std::shared_ptr<const Entry> entry = FindLocked(path, st);
+        if (entry) {
+            Metrics::Add(Metrics::FILE_CACHE_HITS);
+            return entry;
+        }
+        if (!load || m_capacity == 0 || static_cast<size_t>(st.st_size) > m_maxFileSize) {
+            return nullptr;
+        }
+    }
+    Metrics::Add(Metrics::FILE_CACHE_MISSES);
+    std::shared_ptr<const Entry> entry = Load(path, st);
+    if (!entry) {
+        return nullptr;
+    }
+    Insert(path, entry);
+    return entry;
+}
+
+std::shared_ptr<const FileCache::Entry> FileCache::Find(const std::string &key, const struct stat &st) {
+    std::lock_guard<ServerMutex> locker(m_mutex);
+    return FindLocked(key, st);
+}
+
+void FileCache::Insert(const std::string &key, std::shared_ptr<const Entry> entry) {
+    std::lock_guard<ServerMutex> locker(m_mutex);
+    InsertLocked(key, std::move(entry));
+}
+
+std::shared_ptr<const FileCache::Entry> FileCache::FindLocked(const std::string &key, const struct stat &st) {
+    auto it = m_index.find(key);
+    if (it == m_index.end()) {
+        return nullptr;
+    }
+    if (Matches(*it->second->second, st)) {
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return it->second->second;
+    }
+    m_bytes -= it->second->second->data.size(); //文件已被修改
+    m_lru.erase(it->second);
+    m_index.erase(it);
+    return nullptr;
+}
+
+void FileCache::InsertLocked(const std::string &key, std::shared_ptr<const Entry> entry) {
+    if (m_capacity == 0) {
+        return;
+    }
+    auto it = m_index.find(key);
+    if (it != m_index.end()) { //其他线程同时读入了同一个文件
+        m_bytes -= it->second->second->data.size();
+        m_lru.erase(it->second);
+        m_index.erase(it);
+    }
+    m_bytes += entry->data.size();
+    m_lru.emplace_front(key, std::move(entry));
+    m_index[key] = m_lru.begin();
+    while (m_bytes > m_capacity && !m_lru.empty()) {
+        m_bytes -= m_lru.back().second->data.size();
+        m_index.erase(m_lru.back().first);
+        m_lru.pop_back();
+    }
+}
+
+size_t FileCache::Bytes() {
+    std::lock_guard<ServerMutex> locker(m_mutex);
+    return m_bytes;
+}
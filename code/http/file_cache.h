@@ -0,0 +1,64 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include "../metrics/lock_stats.h"
+#include <list>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+
+/*小文件内容缓存，按最近最少使用淘汰
+ *以调用者传入的stat结果(inode、大小、修改时间)校验，文件被修改后自动失效；
+ *返回的Entry由shared_ptr持有，被淘汰时正在发送它的连接不受影响
+ *Encoded()是另一个实例，以"路径:编码"为键缓存即时压缩的结果，按原文件的stat校验；
+ *Headers()缓存各文件预先生成的响应头，见HttpResponse::WriteHeaderBlock*/
+class FileCache
+{
+public:
+    struct Entry {
+        std::string data;
+        ino_t ino;
+        off_t size;
+        struct timespec mtime;
+    };
+
+    static FileCache *Instance();
+    static FileCache *Encoded();
+    static FileCache *Headers();
+    /*capacity为缓存总字节数，为0时不缓存；大于maxFileSize的文件不缓存*/
+    void Init(size_t capacity, size_t maxFileSize);
+    /*命中时返回缓存内容；未命中且load为true时读入文件并加入缓存，否则返回nullptr*/
+    std::shared_ptr<const Entry> Get(const std::string &path, const struct stat &st, bool load);
+    /*只查找，不计入命中统计；内容与st不一致的项被移除*/
+    std::shared_ptr<const Entry> Find(const std::string &key, const struct stat &st);
+    /*加入或替换key对应的项，超过容量时淘汰最久未使用的项*/
+    void Insert(const std::string &key, std::shared_ptr<const Entry> entry);
+    size_t Bytes();
+    size_t MaxFileSize() const {
+        return m_maxFileSize;
+    }
+    size_t Capacity() const {
+        return m_capacity;
+    }
+
+private:
+    typedef std::list<std::pair<std::string, std::shared_ptr<const Entry>>> LruList;
+    ServerMutex m_mutex;
+    LruList m_lru; //表头为最近使用
+    std::unordered_map<std::string, LruList::iterator> m_index;
+    size_t m_capacity;
+    size_t m_maxFileSize;
+    size_t m_bytes;
+
+    explicit FileCache(const char *name);
+    /*在锁内调用*/
+    std::shared_ptr<const Entry> FindLocked(const std::string &key, const struct stat &st);
+    void InsertLocked(const std::string &key, std::shared_ptr<const Entry> entry);
+    ~FileCache() = default;
+    static bool Matches(const Entry &entry, const struct stat &st);
+    /*在锁外读文件，读取失败或读到的长度与stat不一致时返回nullptr*/
+    static std::shared_ptr<const Entry> Load(const std::string &path, const struct stat &st);
+};
+
+#endif // !FILE_CACHE_H
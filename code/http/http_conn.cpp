@@ -1,16 +1,38 @@
 #include "http_conn.h"
+#include "../metrics/metrics.h"
+#include "../metrics/tracer.h"
+#include "warmup.h"
+#include <algorithm>
 #include <arpa/inet.h>
+#include <cstring>
 #include <sys/uio.h>
 
 /*静态成员变量必须定义，但可以不用初始化*/
 const char *HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
+int64_t HttpConn::slowRequestNs = 0;
+bool HttpConn::useCork = false;
+size_t HttpConn::highWater = 256 * 1024;
+size_t HttpConn::lowWater = 64 * 1024;
+size_t HttpConn::writeBudget = 1024 * 1024;
+std::atomic<int64_t> HttpConn::outgoingBytes(0);
 bool HttpConn::isET;
 
 HttpConn::HttpConn() {
     m_fd = -1;
     m_addr = {0};
     m_isClosed = true;
+    m_outBytes = 0;
+    m_traceId = 0;
+    m_traceDecided = false;
+    m_queuedNs = 0;
+    m_taskStartNs = 0;
+    m_readStartNs = 0;
+    m_readEndNs = 0;
+    m_corked = false;
+    m_inPool = false;
+    m_timedOut = false;
+    m_keepAlive = false;
 }
 
 HttpConn::~HttpConn() {
@@ -24,12 +46,28 @@ void HttpConn::Init(int sockFd, const sockaddr_in &addr) {
     m_fd = sockFd;
     m_writeBuff.RetrieveAll();
     m_readBuff.RetrieveAll();
+    m_out.clear();
+    m_sent.clear();
+    m_outBytes = 0;
     m_isClosed = false;
+    m_timing = RequestTiming();
+    m_traceId = 0;
+    m_traceDecided = false;
+    m_corked = false;
+    m_inPool = false;
+    m_timedOut = false;
+    m_keepAlive = false;
+    m_request.Init();
     LOG_INFO("client[%d](%s:%d) come in, uesrCount now:%d", m_fd, GetIP(), GetPort(), (int)userCount);
 }
 
 void HttpConn::Close() {
     m_response.UnmapFile();
+    m_request.Init(); //删除未处理完的消息体的临时文件
+    m_out.clear();
+    m_sent.clear();
+    outgoingBytes -= m_outBytes;
+    m_outBytes = 0;
     if (m_isClosed == false) {
         m_isClosed = true;
         userCount--;
@@ -56,62 +94,296 @@ int HttpConn::GetPort() const {
 
 ssize_t HttpConn::Read(int *saveErrno) {
     ssize_t len = -1;
+    size_t total = 0;
+    int64_t start = NowNs();
     do {
         len = m_readBuff.ReadFd(m_fd, saveErrno); //从fd中读取数据
         if (len <= 0) {
             break;
         }
+        total += len;
+        if (isET && m_readBuff.ReadableBytes() >= std::max(highWater, HttpRequest::MAX_HEADER_BYTES + 1)) {
+            /*未处理的数据过多时暂停读，剩余数据留在内核中；重新注册EPOLLIN时epoll_ctl会重新检查就绪状态。
+             *消息体边到达边被解析取走，不会因此停住；不少于请求头上限，超长的请求头总能被发现*/
+            Metrics::Add(Metrics::READ_PAUSES);
+            break;
+        }
     } while (isET); // ET模式要求程序必须立即处理事件，因此要一次性从fd中读取完数据
+    if (total > 0) {
+        if (m_timing.firstReadNs == 0) {
+            m_timing.firstReadNs = start;
+        }
+        /*读到的数据可能属于还没有开始解析的请求，记下起止时间，采样决定之后再补记*/
+        m_readStartNs = start;
+        m_readEndNs = NowNs();
+        Tracer::Record(m_traceId, Tracer::READ, m_readStartNs, m_readEndNs);
+    }
     return len;
 }
 
 ssize_t HttpConn::Write(int *saveErrno) {
     ssize_t len = -1;
-    do {
-        /*集中写，将写缓冲区和文件中的内容一并写入m_fd中*/
-        len = writev(m_fd, m_iov, m_iovCnt);
+    size_t written = 0;
+    int64_t start = NowNs();
+    /*头部和文件在同一次集中写中发出，不会单独产生小包；较大的响应要写多次，
+     *写入期间塞住socket只发满MSS的报文，写完后拔塞推送剩余数据*/
+    if (useCork && !m_corked && ToWriteBytes() > CORK_MIN_BYTES) {
+        SetCork(true);
+    }
+    struct iovec iov[MAX_IOV];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    /*写完、发送缓冲区满(EAGAIN)或者用完本次的写预算为止；慢速的对端不会让线程在这里空转*/
+    while (m_outBytes > 0 && written < writeBudget) {
+        /*集中写，将排队的响应头和文件内容一并写入m_fd中*/
+        int cnt = 0;
+        const char *buff = m_writeBuff.Peek();
+        for (size_t i = 0; i < m_out.size() && cnt + 2 <= MAX_IOV; i++) {
+            const OutSegment &seg = m_out[i];
+            if (seg.buffLen > 0) {
+                iov[cnt].iov_base = const_cast<char *>(buff);
+                iov[cnt].iov_len = seg.buffLen;
+                buff += seg.buffLen;
+                cnt++;
+            }
+            if (seg.fileLen > 0) {
+                iov[cnt].iov_base = const_cast<char *>(seg.file.get() + seg.fileOffset);
+                iov[cnt].iov_len = seg.fileLen;
+                cnt++;
+            }
+        }
+        msg.msg_iovlen = cnt;
+        /*MSG_NOSIGNAL避免对端关闭时触发SIGPIPE终止进程*/
+        len = sendmsg(m_fd, &msg, MSG_NOSIGNAL);
         if (len <= 0) {
             *saveErrno = errno;
             break;
         }
-        if (m_iov[0].iov_len + m_iov[1].iov_len == 0) {
-            break;
-        } else if (static_cast<size_t>(len) > m_iov[0].iov_len) {
-            m_iov[1].iov_base = (uint8_t *)m_iov[1].iov_base + (len - m_iov[0].iov_len);
-            m_iov[1].iov_len -= (len - m_iov[0].iov_len);
-            if (m_iov[0].iov_len) {
-                m_writeBuff.RetrieveAll();
-                m_iov[0].iov_len = 0;
-            }
-        } else {
-            m_iov[0].iov_base = (uint8_t *)m_iov[0].iov_base + len;
-            m_iov[0].iov_len -= len;
-            m_writeBuff.Retrieve(len);
+        Metrics::Add(Metrics::BYTES_OUT, len);
+        written += len;
+        Consume(len);
+    }
+    if (m_outBytes > 0 && written >= writeBudget) {
+        Metrics::Add(Metrics::WRITE_YIELDS);
+    }
+    int64_t end = NowNs();
+    Metrics::Record(Metrics::WRITE, end - start);
+    Tracer::Record(m_traceId, Tracer::WRITE, start, end);
+    if (ToWriteBytes() == 0) {
+        if (m_corked) {
+            SetCork(false);
+        }
+        if (m_request.State() == HttpRequest::FINISH) {
+            m_traceId = 0; //没有正在解析的请求，之后的排队和读不属于已写完的请求
         }
-    } while (isET || ToWriteBytes() > 10240); //当ET模式或要写入的字节过大，必须一次性向fd中写完数据
+    }
     return len;
 }
 
-bool HttpConn::Process() {
-    m_request.Init();
-    if (m_readBuff.ReadableBytes() <= 0) {
+void HttpConn::Consume(size_t len) {
+    m_outBytes -= len;
+    outgoingBytes -= len;
+    while (len > 0) {
+        assert(!m_out.empty());
+        OutSegment &seg = m_out.front();
+        size_t n = std::min(len, seg.buffLen);
+        m_writeBuff.Retrieve(n);
+        seg.buffLen -= n;
+        len -= n;
+        n = std::min(len, seg.fileLen);
+        seg.fileOffset += n;
+        seg.fileLen -= n;
+        len -= n;
+        if (seg.buffLen == 0 && seg.fileLen == 0 && !(seg.chunked && NextChunk(seg))) {
+            bool last = seg.last;
+            m_out.pop_front(); //释放文件内容的持有
+            if (last) {
+                FinishRequest(NowNs());
+            }
+        }
+    }
+}
+
+bool HttpConn::NextChunk(OutSegment &seg) {
+    TraceSpan span(Tracer::RESPOND); //压缩下一段，在写的过程中进行
+    size_t len;
+    if (!seg.chunked->Next(seg.file, len)) {
+        if (seg.chunked->Failed()) {
+            m_keepAlive = false; //消息体不完整，写完已有的部分后关闭连接
+        }
+        seg.chunked.reset();
         return false;
-    } else if (m_request.Parse(m_readBuff)) {
+    }
+    seg.fileOffset = 0;
+    seg.fileLen = len;
+    m_outBytes += len;
+    outgoingBytes += len;
+    m_sent.back().bytesOut += len; //chunked响应总是发送队列中的最后一个
+    return true;
+}
+
+int HttpConn::ProcessRequests(size_t inlineMaxBytes) {
+    int count = 0;
+    while (m_readBuff.ReadableBytes() > 0) {
+        if (count > 0 && !m_keepAlive) {
+            break; //之后的数据属于一个将被关闭的连接
+        }
+        if (m_outBytes >= highWater) {
+            Metrics::Add(Metrics::WRITE_HIGH_WATER);
+            break;
+        }
+        if (!m_out.empty() && m_out.back().chunked) {
+            break; //chunked响应在发送中逐段生成，发完之前后续响应不能排在它后面
+        }
+        if (inlineMaxBytes > 0 && !CanServeInline(inlineMaxBytes)) {
+            break;
+        }
+        if (!ProcessOne()) {
+            break; //请求还不完整，等待更多数据
+        }
+        count++;
+    }
+    return count;
+}
+
+bool HttpConn::ProcessOne() {
+    if (m_request.State() == HttpRequest::FINISH) {
+        m_request.Init(); //上一个请求已处理完，开始解析下一个
+        m_traceDecided = false;
+    }
+    if (!m_traceDecided) {
+        /*每个请求只做一次采样决定：流水线中的多个请求各自采样，跨多次读到达的请求不会重复采样；
+         *本次任务的排队和读在决定之前已经发生，被采样时补记*/
+        m_traceDecided = true;
+        SetTrace(Tracer::Sample());
+        if (m_traceId) {
+            Tracer::Record(m_traceId, Tracer::QUEUE, m_queuedNs, m_taskStartNs);
+            if (m_readEndNs > 0) {
+                Tracer::Record(m_traceId, Tracer::READ, m_readStartNs, m_readEndNs);
+            }
+        }
+    }
+    int64_t start = NowNs();
+    if (m_timing.firstReadNs == 0) {
+        m_timing.firstReadNs = start; //流水线中已在缓冲区里的请求从开始解析时计时
+    }
+    int64_t dbNs = m_request.DbNs();
+    size_t unparsed = m_readBuff.ReadableBytes();
+    HttpRequest::PARSE_RESULT result = m_request.Parse(m_readBuff);
+    int64_t parsedAt = NowNs();
+    m_timing.bytesIn += unparsed - m_readBuff.ReadableBytes();
+    Tracer::Record(m_traceId, Tracer::PARSE, start, parsedAt);
+    dbNs = m_request.DbNs() - dbNs;
+    m_timing.parseNs += parsedAt - start - dbNs;
+    m_timing.dbNs += dbNs;
+    if (result == HttpRequest::NEED_MORE) {
+        return false;
+    }
+    Metrics::Record(Metrics::PARSE, parsedAt - start);
+    if (result == HttpRequest::COMPLETE) {
         LOG_DEBUG("%s", m_request.GetPath().c_str());
-        m_response.Init(srcDir, m_request.GetPath(), m_request.IsKeepAlive(), 200);
+        m_keepAlive = m_request.IsKeepAlive();
+        m_response.Init(srcDir, m_request.GetPath(), m_keepAlive, 200);
+        m_response.SetAcceptEncoding(m_request.GetHeader("Accept-Encoding"));
+        m_response.SetAcceptChunked(m_request.GetVersion() == "1.1");
+        if (m_request.GetMethod() == "GET") {
+            m_response.SetConditions(m_request.GetHeader("If-None-Match"), m_request.GetHeader("If-Modified-Since"));
+            m_response.SetRange(m_request.GetHeader("Range"), m_request.GetHeader("If-Range"));
+        }
     } else {
-        m_response.Init(srcDir, m_request.GetPath(), false, 400);
+        m_keepAlive = false; //请求的边界已无法确定，应答后关闭连接
+        m_response.Init(srcDir, m_request.GetPath(), false, m_request.ErrorCode());
     }
-    /*集中写*/
+    /*集中写：响应头追加到写缓冲区末尾，文件内容(或Range请求的各段)按Parts的顺序排在其间*/
     m_response.Respond(m_writeBuff);
-    m_iov[0].iov_base = const_cast<char *>(m_writeBuff.Peek());
-    m_iov[0].iov_len = m_writeBuff.ReadableBytes();
-    m_iovCnt = 1;
-    if (m_response.FileLen() > 0 && m_response.File()) {
-        m_iov[1].iov_base = m_response.File();
-        m_iov[1].iov_len = m_response.FileLen();
-        m_iovCnt = 2;
-    }
-    LOG_DEBUG("filesize:%d,%d to %d", m_response.FileLen(), m_iovCnt, ToWriteBytes());
+    int64_t respondedAt = NowNs();
+    Metrics::Record(Metrics::RESPOND, respondedAt - parsedAt);
+    Tracer::Record(m_traceId, Tracer::RESPOND, parsedAt, respondedAt);
+    m_timing.respondNs += respondedAt - parsedAt;
+    Metrics::CountStatus(m_response.Code());
+    int code = m_response.Code();
+    if (code == 200 || code == 206 || code == 304) {
+        Warmup::RecordHit(m_request.GetPath()); //下次启动时按命中次数预热
+    }
+    size_t bytes = 0;
+    size_t segments = m_out.size();
+    for (const HttpResponse::BodyPart &part : m_response.Parts()) {
+        OutSegment seg = {part.buffLen, nullptr, part.fileOffset, part.fileLen, nullptr, false};
+        if (part.fileLen > 0) {
+            seg.file = m_response.FileHolder();
+        }
+        bytes += part.buffLen + part.fileLen;
+        m_out.push_back(std::move(seg));
+    }
+    m_outBytes += bytes;
+    outgoingBytes += bytes;
+    /*本请求的计时随响应一起排队，m_request和m_timing转而用于流水线中的下一个请求*/
+    m_timing.method = m_request.GetMethod();
+    m_timing.path = m_request.GetPath();
+    m_timing.respondedNs = respondedAt;
+    m_timing.bytesOut = bytes;
+    m_sent.push_back(std::move(m_timing));
+    m_timing = RequestTiming();
+    if (m_response.Chunked()) {
+        m_out.push_back({0, nullptr, 0, 0, m_response.Chunked(), false});
+        if (!NextChunk(m_out.back())) {
+            m_out.pop_back();
+        }
+    }
+    if (m_out.size() > segments) {
+        m_out.back().last = true;
+    } else {
+        FinishRequest(NowNs()); //没有要发送的内容
+    }
+    m_response.UnmapFile();
+    LOG_DEBUG("filesize:%d to %d", m_response.FileLen(), ToWriteBytes());
     return true;
-}
\ No newline at end of file
+}
+
+bool HttpConn::CanServeInline(size_t maxBytes) const {
+    /*正在接收上一个请求的消息体*/
+    if (m_request.State() != HttpRequest::REQUEST_LINE && m_request.State() != HttpRequest::FINISH) {
+        return false;
+    }
+    const char *begin = m_readBuff.Peek();
+    const char *end = m_readBuff.BeginWriteConst();
+    /*POST等带消息体的请求可能访问数据库，只处理GET*/
+    if (end - begin < 4 || memcmp(begin, "GET ", 4) != 0) {
+        return false;
+    }
+    const char *HEADER_END = "\r\n\r\n";
+    if (std::search(begin, end, HEADER_END, HEADER_END + 4) == end) {
+        return false; //请求头还不完整
+    }
+    const char *pathEnd = std::find(begin + 4, end, ' ');
+    std::string path(begin + 4, pathEnd);
+    HttpRequest::NormalizePath(path);
+    bool http11 = end - pathEnd > 9 && memcmp(pathEnd, " HTTP/1.1\r", 10) == 0;
+    return HttpResponse::ServableFromCache(srcDir, path, maxBytes,
+                                           HttpRequest::FindHeader(begin, end, "If-None-Match"),
+                                           HttpRequest::FindHeader(begin, end, "If-Modified-Since"),
+                                           HttpRequest::FindHeader(begin, end, "Accept-Encoding"), http11);
+}
+
+void HttpConn::SetCork(bool on) {
+    int optval = on ? 1 : 0;
+    if (setsockopt(m_fd, IPPROTO_TCP, TCP_CORK, &optval, sizeof(optval)) == 0) {
+        m_corked = on;
+    }
+}
+
+void HttpConn::FinishRequest(int64_t endNs) {
+    assert(!m_sent.empty());
+    const RequestTiming &t = m_sent.front();
+    int64_t total = endNs - t.firstReadNs;
+    /*write是响应排入队列到最后一个字节发出的时间，包括等待前面的响应发完和socket可写*/
+    if (slowRequestNs > 0 && t.firstReadNs > 0 && total >= slowRequestNs) {
+        Metrics::Add(Metrics::SLOW_REQUESTS);
+        LOG_WARN("Slow request: %s %s fd:%d total:%.3fms queue:%.3fms parse:%.3fms respond:%.3fms db:%.3fms "
+                 "write:%.3fms in:%zu out:%zu bytes",
+                 t.method.c_str(), t.path.c_str(), m_fd, total / 1e6, t.queueNs / 1e6, t.parseNs / 1e6,
+                 t.respondNs / 1e6, t.dbNs / 1e6, (endNs - t.respondedNs) / 1e6, t.bytesIn, t.bytesOut);
+    }
+    m_sent.pop_front();
+}
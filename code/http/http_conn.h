@@ -1,22 +1,79 @@
 #ifndef HTTP_CONN_H
 #define HTTP_CONN_H
 
+#include "../metrics/tracer.h"
 #include "parse_http.h"
 #include "respond_http.h"
 #include <bits/types/struct_iovec.h>
+#include <deque>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
 class HttpConn
 {
 private:
     int m_fd;
     struct sockaddr_in m_addr;
     bool m_isClosed;
-    int m_iovCnt;
-    struct iovec m_iov[2];
+    /*待发送的响应，按顺序先发写缓冲区中的buffLen字节(响应头)，再发文件内容；
+     *流水线中的多个响应依次排队，文件内容由file共享持有，发送完才释放；
+     *chunked不为空时file是当前的chunk，发完后再从chunked取下一个；last表示是一个响应的最后一段*/
+    struct OutSegment {
+        size_t buffLen;
+        std::shared_ptr<const char> file;
+        size_t fileOffset;
+        size_t fileLen;
+        std::shared_ptr<HttpResponse::ChunkedBody> chunked;
+        bool last;
+    };
+    std::deque<OutSegment> m_out;
+    size_t m_outBytes; //m_out中待发送的总字节数
     Buffer m_readBuff;
     Buffer m_writeBuff;
     HttpResponse m_response;
     HttpRequest m_request;
+    /*一个请求从读到第一个字节到写完最后一个字节之间各阶段的耗时(纳秒)，用于慢请求日志*/
+    struct RequestTiming {
+        std::string method;
+        std::string path;
+        int64_t firstReadNs = 0; //为0表示还没有开始计时
+        int64_t queueNs = 0;
+        int64_t parseNs = 0; //不含数据库访问
+        int64_t respondNs = 0;
+        int64_t dbNs = 0;
+        int64_t respondedNs = 0; //响应排入发送队列的时间
+        size_t bytesIn = 0;      //请求的字节数
+        size_t bytesOut = 0;     //响应的字节数
+    };
+    RequestTiming m_timing; //正在解析的请求
+    /*响应已排入发送队列、还没有发完的请求，按顺序与m_out中last为true的各段一一对应；
+     *流水线中的每个请求在自己的响应发完时单独计时*/
+    std::deque<RequestTiming> m_sent;
+    uint64_t m_traceId;     //当前请求的追踪id，为0表示未被采样
+    bool m_traceDecided;    //当前请求是否已经做过采样决定
+    int64_t m_queuedNs;     //任务投递到线程池的时间
+    int64_t m_taskStartNs;  //当前任务开始执行的时间
+    int64_t m_readStartNs;  //当前任务中读socket的起止时间，没有读到数据时为0
+    int64_t m_readEndNs;
+    bool m_corked;      //是否设置了TCP_CORK
+    bool m_inPool;      //已交给线程池、还没有收到完成通知，只在事件循环中访问
+    bool m_timedOut;    //在线程池处理期间超时，收到完成通知后关闭，只在事件循环中访问
+    bool m_keepAlive;   //最近一个处理完的请求是否keep-alive；m_request可能已经开始解析下一个请求
+
+    /*超过该字节数的响应写入期间设置TCP_CORK*/
+    static const int CORK_MIN_BYTES = 64 * 1024;
+    /*一次sendmsg最多提交的iovec个数*/
+    static const int MAX_IOV = 64;
+    /*继续解析读缓冲区中的请求，请求完整(或有误)时生成的响应追加到发送队列末尾并返回true；
+     *还不完整时返回false，已到达的消息体已从读缓冲区取走，解析状态保留到下次*/
+    bool ProcessOne();
+    /*从发送队列头部取走已发送的len字节*/
+    void Consume(size_t len);
+    /*取得chunked响应的下一个chunk放入seg，已经发完时返回false*/
+    bool NextChunk(OutSegment &seg);
+    void SetCork(bool on);
+    /*最早的一个响应写完，检查该请求的总耗时，超过阈值时记录日志*/
+    void FinishRequest(int64_t endNs);
 
 public:
     static bool isET;
@@ -24,6 +81,16 @@ public:
     /*原子对象的主要特征是，从不同的线程访问这个包含的值不会导致数据竞争
      *（即，这样做是明确定义的行为，访问正确排序）*/
     static std::atomic<int> userCount;
+    /*总耗时超过该值(纳秒)的请求记录警告日志，为0时关闭*/
+    static int64_t slowRequestNs;
+    static bool useCork;
+    /*待发送字节数达到高水位时不再处理流水线中的后续请求，读缓冲区达到高水位时暂停读；
+     *写到低水位以下才继续处理后续请求；每次Write最多写writeBudget字节，避免一个连接长时间占用线程*/
+    static size_t highWater;
+    static size_t lowWater;
+    static size_t writeBudget;
+    /*所有连接待发送的字节数之和*/
+    static std::atomic<int64_t> outgoingBytes;
 
     HttpConn();
     ~HttpConn();
@@ -34,17 +101,60 @@ public:
     int GetPort() const;
     /*初始化*/
     void Init(int sockFd, const sockaddr_in &addr);
-    /*解析接收的请求报文，并准备响应报文*/
-    bool Process();
+    /*依次处理读缓冲区中的请求，响应排入发送队列，直到：请求不完整、待发送字节数达到高水位、
+     *或者处理了一个非keep-alive的请求；inlineMaxBytes不为0时只处理CanServeInline的请求。返回处理完的请求数*/
+    int ProcessRequests(size_t inlineMaxBytes);
+    /*读缓冲区中是一个完整的GET请求，且响应可以完全由小文件缓存生成、不超过maxBytes时返回true，
+     *此时事件循环可以直接处理而不必交给线程池*/
+    bool CanServeInline(size_t maxBytes) const;
+    /*读缓冲区中还有未处理的数据*/
+    bool HasPendingRequest() const {
+        return m_readBuff.ReadableBytes() > 0;
+    }
     /*从m_fd中接收数据*/
     ssize_t Read(int *saveErrno);
     /*往m_fd中发送数据*/
     ssize_t Write(int *saveErrno);
-    int ToWriteBytes() {
-        return m_iov[0].iov_len + m_iov[1].iov_len;
+    size_t ToWriteBytes() const {
+        return m_outBytes;
     }
     bool IsKeepAlive() const {
-        return m_request.IsKeepAlive();
+        return m_keepAlive;
+    }
+    /*在事件循环中投递任务前调用*/
+    void OnEnqueue() {
+        m_queuedNs = NowNs();
+    }
+    /*工作线程开始执行任务时调用，累计排队时间并返回当前时间*/
+    int64_t OnTaskStart() {
+        int64_t now = NowNs();
+        m_timing.queueNs += now - m_queuedNs;
+        m_taskStartNs = now;
+        m_readStartNs = m_readEndNs = 0;
+        return now;
+    }
+    /*设置当前请求的追踪id，id来自Tracer::Sample；开始解析一个新请求时调用*/
+    void SetTrace(uint64_t id) {
+        m_traceId = id;
+        Tracer::SetCurrent(id);
+    }
+    bool InPool() const {
+        return m_inPool;
+    }
+    void SetInPool(bool inPool) {
+        m_inPool = inPool;
+    }
+    bool TimedOut() const {
+        return m_timedOut;
+    }
+    void SetTimedOut() {
+        m_timedOut = true;
+    }
+    uint64_t TraceId() const {
+        return m_traceId;
+    }
+    int64_t QueuedNs() const {
+        return m_queuedNs;
     }
 };
 
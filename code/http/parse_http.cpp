@@ -1,56 +1,228 @@
 #include "parse_http.h"
+#include "../metrics/tracer.h"
+#include "../utils/str_hash.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <strings.h>
+#include <unistd.h>
 
-const std::unordered_set<std::string> HttpRequest::DEFAULT_HTML{
-    "/index", "/register", "/login", "/welcome", "/video", "/picture",
-};
+namespace {
+
+bool WriteAll(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+/*在dir下创建匿名临时文件，关闭后自动删除；文件系统不支持O_TMPFILE时创建后立即unlink*/
+int OpenTempFile(const std::string &dir) {
+    int fd = open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd >= 0 || (errno != EOPNOTSUPP && errno != EISDIR)) {
+        return fd;
+    }
+    std::string path = dir + "/webserver_bodyXXXXXX";
+    fd = mkostemp(&path[0], O_CLOEXEC);
+    if (fd >= 0) {
+        unlink(path.c_str());
+    }
+    return fd;
+}
+
+bool IsOws(char ch) {
+    return ch == ' ' || ch == '\t';
+}
+
+} // namespace
+
+bool HttpRequest::IsDefaultHtml(const std::string &path) {
+    const char *str = path.data();
+    size_t len = path.size();
+    switch (StrHash(str, len)) {
+        case StrHash("/index"):
+            return StrEquals(str, len, "/index");
+        case StrHash("/register"):
+            return StrEquals(str, len, "/register");
+        case StrHash("/login"):
+            return StrEquals(str, len, "/login");
+        case StrHash("/welcome"):
+            return StrEquals(str, len, "/welcome");
+        case StrHash("/video"):
+            return StrEquals(str, len, "/video");
+        case StrHash("/picture"):
+            return StrEquals(str, len, "/picture");
+        default:
+            return false;
+    }
+}
+
+int HttpRequest::DefaultHtmlTag(const std::string &path) {
+    const char *str = path.data();
+    size_t len = path.size();
+    switch (StrHash(str, len)) {
+        case StrHash("/register.html"):
+            return StrEquals(str, len, "/register.html") ? 0 : -1;
+        case StrHash("/login.html"):
+            return StrEquals(str, len, "/login.html") ? 1 : -1;
+        default:
+            return -1;
+    }
+}
+
+UserStore *HttpRequest::userStore = nullptr;
+size_t HttpRequest::maxBodyBytes = 64 * 1024 * 1024;
+std::string HttpRequest::bodyTmpDir = "/tmp";
+
+HttpRequest::~HttpRequest() {
+    CloseBody();
+}
 
-const std::unordered_map<std::string, int> HttpRequest::DEFAULT_HTML_TAG{
-    {"/register.html", 0},
-    {"/login.html", 1},
-};
 void HttpRequest::Init() {
-    m_method = m_path = m_version = m_content = "";
+    m_method = m_path = m_version = "";
+    /*大的表单或消息体用过的内存不随连接保留*/
+    if (m_content.capacity() > 4096) {
+        std::string().swap(m_content);
+    } else {
+        m_content.clear();
+    }
     m_state = REQUEST_LINE;
     m_header.clear();
     m_post.clear();
+    m_dbNs = 0;
+    m_error = 0;
+    m_bodyLeft = 0;
+    m_bodyLen = 0;
+    m_trailerBytes = 0;
+    CloseBody();
 }
 
-bool HttpRequest::Parse(Buffer &buff) {
-    const char *CRLF = "\r\n";       //回车换行
-    if (buff.ReadableBytes() <= 0) { //没有可读数据
-        return false;
+void HttpRequest::CloseBody() {
+    if (m_bodyFd >= 0) {
+        close(m_bodyFd);
+        m_bodyFd = -1;
     }
-    while (buff.ReadableBytes() && m_state != FINISH) {
-        /*search用于在一个序列中搜索指定的子序列，并返回第一次出现该子序列的位置*/
-        const char *lineEnd = std::search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
-        std::string line(buff.Peek(), lineEnd); //获取一行数据，去除了\r\n
+}
+
+HttpRequest::PARSE_RESULT HttpRequest::Parse(Buffer &buff) {
+    const char *CRLF = "\r\n"; //回车换行
+    while (m_state != FINISH) {
+        const char *begin = buff.Peek();
+        const char *end = buff.BeginWriteConst();
         switch (m_state) {
-            case REQUEST_LINE:
-                if (!ParseRequestLine(line)) { //解析请求行
-                    return false;
+            case REQUEST_LINE: {
+                /*跳过请求之间多余的空行(有的客户端在POST消息体后多发一个CRLF)*/
+                while (end - begin >= 2 && begin[0] == '\r' && begin[1] == '\n') {
+                    buff.Retrieve(2);
+                    begin += 2;
+                }
+                const char *HEADER_END = "\r\n\r\n";
+                const char *headerEnd = std::search(begin, end, HEADER_END, HEADER_END + 4);
+                if (headerEnd == end) {
+                    return buff.ReadableBytes() > MAX_HEADER_BYTES ? Fail(400) : NEED_MORE; //请求头不完整
+                }
+                if (static_cast<size_t>(headerEnd - begin) > MAX_HEADER_BYTES) {
+                    return Fail(400);
+                }
+                /*请求行和各请求头都以CRLF结尾，最后一个请求头的CRLF在headerEnd处*/
+                const char *blockEnd = headerEnd + 2;
+                const char *lineEnd = std::search(begin, blockEnd, CRLF, CRLF + 2);
+                if (!ParseRequestLine(begin, lineEnd)) {
+                    return Fail(400);
                 }
                 ParsePath(); //解析路径
-                break;
-            case HEADER:
-                ParseHeader(line); //解析请求头
-                if (buff.ReadableBytes() <= 2) {
-                    m_state = FINISH;
+                for (const char *line = lineEnd + 2; line < blockEnd; line = lineEnd + 2) {
+                    lineEnd = std::search(line, blockEnd, CRLF, CRLF + 2);
+                    if (!ParseHeader(line, lineEnd)) {
+                        return Fail(400);
+                    }
+                }
+                buff.RetrieveUntil(headerEnd + 4);
+                if (!ParseFraming()) {
+                    return INVALID;
                 }
                 break;
+            }
             case CONTENT:
-                ParseContent(line); //解析消息
+            case CHUNK_DATA: {
+                size_t n = std::min(buff.ReadableBytes(), m_bodyLeft);
+                if (n == 0) {
+                    return NEED_MORE;
+                }
+                if (!AppendBody(begin, n)) {
+                    return INVALID;
+                }
+                buff.Retrieve(n);
+                m_bodyLeft -= n;
+                if (m_bodyLeft > 0) {
+                    return NEED_MORE;
+                }
+                if (m_state == CHUNK_DATA) {
+                    m_state = CHUNK_END;
+                } else if (!FinishBody()) {
+                    return INVALID;
+                }
                 break;
+            }
+            case CHUNK_END:
+                if (buff.ReadableBytes() < 2) {
+                    return NEED_MORE;
+                }
+                if (begin[0] != '\r' || begin[1] != '\n') {
+                    return Fail(400); //chunk的长度与内容不符
+                }
+                buff.Retrieve(2);
+                m_state = CHUNK_SIZE;
+                break;
+            case CHUNK_SIZE:
+            case TRAILER: {
+                const char *lineEnd = std::search(begin, end, CRLF, CRLF + 2);
+                /*还没有CRLF时lineEnd为end，超过上限的半行同样拒绝，不会一直等下去；
+                 *trailer的上限包括已读的各行及其CRLF(结束的空行不算)，以加法比较，m_trailerBytes不会超过上限*/
+                size_t len = lineEnd - begin;
+                if (m_state == CHUNK_SIZE ? len > MAX_CHUNK_LINE
+                                          : len > 0 && m_trailerBytes + len + 2 > MAX_HEADER_BYTES) {
+                    return Fail(400);
+                }
+                if (lineEnd == end) {
+                    return NEED_MORE;
+                }
+                if (m_state == CHUNK_SIZE) {
+                    if (!ParseChunkSize(begin, lineEnd)) {
+                        return INVALID;
+                    }
+                } else if (lineEnd == begin) {
+                    if (!FinishBody()) { //空行，chunked消息结束
+                        return INVALID;
+                    }
+                } else {
+                    m_trailerBytes += lineEnd - begin + 2; //trailer中的字段不使用
+                }
+                buff.RetrieveUntil(lineEnd + 2);
+                break;
+            }
             default:
                 break;
         }
-        /*search函数没有找到在读缓冲区找到\r\n时，回返回写指针位置，此时表示请求不完整或读完了*/
-        if (lineEnd == buff.BeginWrite()) {
-            break;
-        }
-        buff.RetrieveUntil(lineEnd + 2);
     }
     LOG_DEBUG("[%s], [%s], [%s]", m_method.c_str(), m_path.c_str(), m_version.c_str());
-    return true;
+    return COMPLETE;
+}
+
+HttpRequest::PARSE_RESULT HttpRequest::Fail(int code) {
+    m_error = code;
+    LOG_DEBUG("Bad request, state:%d, code:%d", m_state, code);
+    return INVALID;
 }
 
 std::string HttpRequest::GetPath() const {
@@ -69,6 +241,54 @@ std::string HttpRequest::GetVersion() const {
     return m_version;
 }
 
+std::string HttpRequest::GetHeader(const std::string &key) const {
+    auto it = m_header.find(key);
+    return it != m_header.end() ? it->second : "";
+}
+
+size_t HttpRequest::HeaderNameHash::operator()(const std::string &name) const {
+    uint32_t hash = 2166136261u; //与StrHash相同的FNV-1a，按小写计算
+    for (unsigned char ch : name) {
+        hash = (hash ^ static_cast<uint8_t>(tolower(ch))) * 16777619u;
+    }
+    return hash;
+}
+
+bool HttpRequest::HeaderNameEqual::operator()(const std::string &a, const std::string &b) const {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string HttpRequest::FindHeader(const char *begin, const char *end, const char *key) {
+    size_t keyLen = strlen(key);
+    const char *CRLF = "\r\n";
+    const char *line = std::search(begin, end, CRLF, CRLF + 2); //跳过请求行
+    while (line != end) {
+        line += 2;
+        const char *lineEnd = std::search(line, end, CRLF, CRLF + 2);
+        if (lineEnd == line) {
+            break; //空行，请求头结束
+        }
+        if (static_cast<size_t>(lineEnd - line) > keyLen && line[keyLen] == ':' &&
+            strncasecmp(line, key, keyLen) == 0) {
+            const char *value = line + keyLen + 1;
+            while (value < lineEnd && *value == ' ') {
+                value++;
+            }
+            return std::string(value, lineEnd);
+        }
+        line = lineEnd;
+    }
+    return "";
+}
+
 std::string HttpRequest::GetPost(const std::string &key) const {
     assert(key != "");
     if (m_post.count(key) == 1) {
@@ -92,47 +312,168 @@ bool HttpRequest::IsKeepAlive() const {
     return false;
 }
 
-bool HttpRequest::ParseRequestLine(const std::string &line) {
-    std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    std::smatch subMatch; // std::smatch 类型表示一个正则表达式匹配结果的集合
-    if (std::regex_match(line, subMatch, patten)) {
-        m_method = subMatch[1];
-        m_path = subMatch[2];
-        m_version = subMatch[3];
-        m_state = HEADER;
+bool HttpRequest::ParseRequestLine(const char *begin, const char *end) {
+    /*"方法 路径 HTTP/版本"，以单个空格分隔*/
+    const char *sp1 = std::find(begin, end, ' ');
+    const char *sp2 = sp1 == end ? end : std::find(sp1 + 1, end, ' ');
+    const char *version = sp2 == end ? end : sp2 + 1;
+    if (sp1 == begin || sp2 == end || sp2 == sp1 + 1 || end - version < 5 || strncmp(version, "HTTP/", 5) != 0 ||
+        std::find(version, end, ' ') != end) {
+        LOG_ERROR("RequestLine Error");
+        return false;
+    }
+    m_method.assign(begin, sp1);
+    m_path.assign(sp1 + 1, sp2);
+    m_version.assign(version + 5, end);
+    return true;
+}
+
+bool HttpRequest::ParseHeader(const char *begin, const char *end) {
+    /*"名字:值"，值前后的空白不算在内；名字不能为空，也不能含空白：冒号前的空白会让"Transfer-Encoding :"
+     *被不同的实现理解为不同的字段，以空白开头的行是已废弃的折行(obs-fold)，都拒绝(RFC 9112 5.1、5.2)*/
+    const char *colon = std::find(begin, end, ':');
+    if (colon == begin || colon == end || std::find_if(begin, colon, IsOws) != colon) {
+        return false;
+    }
+    const char *value = colon + 1;
+    while (value < end && IsOws(*value)) {
+        value++;
+    }
+    const char *valueEnd = end;
+    while (valueEnd > value && IsOws(valueEnd[-1])) {
+        valueEnd--;
+    }
+    std::string key(begin, colon);
+    HeaderNameEqual equal;
+    bool contentLength = equal(key, "Content-Length");
+    bool transferEncoding = equal(key, "Transfer-Encoding");
+    /*空的、重复且不一致的Content-Length和重复的Transfer-Encoding无法确定消息体的边界，
+     *各方的理解可能不同(请求走私)，拒绝请求；只有大小写不同的名字也是重复*/
+    if ((contentLength || transferEncoding) && value == valueEnd) {
+        return false;
+    }
+    auto it = m_header.find(key);
+    if (it == m_header.end()) {
+        m_header.emplace(std::move(key), std::string(value, valueEnd));
         return true;
     }
-    LOG_ERROR("RequestLine Error");
-    return false;
+    if (transferEncoding ||
+        (contentLength && it->second.compare(0, std::string::npos, value, valueEnd - value) != 0)) {
+        return false;
+    }
+    it->second.assign(value, valueEnd);
+    return true;
 }
 
-void HttpRequest::ParseHeader(const std::string &line) {
-    std::regex patten("^([^:]*): ?(.*)$");
-    std::smatch subMatch;
-    if (std::regex_match(line, subMatch, patten)) {
-        m_header[subMatch[1]] = subMatch[2];
-    } else {
-        m_state = CONTENT;
+bool HttpRequest::ParseFraming() {
+    std::string transferEncoding = GetHeader("Transfer-Encoding");
+    std::string contentLength = GetHeader("Content-Length");
+    if (!transferEncoding.empty()) {
+        /*同时带有两者时各方对消息体边界的理解可能不同(请求走私)，拒绝请求*/
+        if (!contentLength.empty()) {
+            m_error = 400;
+            return false;
+        }
+        if (strcasecmp(transferEncoding.c_str(), "chunked") != 0) {
+            m_error = 501;
+            return false;
+        }
+        m_state = CHUNK_SIZE;
+        return true;
+    }
+    if (contentLength.empty()) {
+        m_state = FINISH; //没有消息体，空行之后是流水线中的下一个请求
+        return true;
     }
+    if (contentLength.size() > 18 ||
+        contentLength.find_first_not_of("0123456789") != std::string::npos) {
+        m_error = 400;
+        return false;
+    }
+    size_t len = strtoull(contentLength.c_str(), nullptr, 10);
+    if (len > maxBodyBytes) {
+        m_error = 413;
+        return false;
+    }
+    if (len == 0) {
+        return FinishBody();
+    }
+    m_bodyLeft = len;
+    m_state = CONTENT;
+    return true;
 }
 
-void HttpRequest::ParseContent(const std::string &line) {
-    m_content = line;
+bool HttpRequest::ParseChunkSize(const char *begin, const char *end) {
+    size_t size = 0;
+    const char *p = begin;
+    for (; p < end && isxdigit(static_cast<unsigned char>(*p)); p++) {
+        if (p - begin >= 15) {
+            m_error = 413;
+            return false;
+        }
+        size = size * 16 + (*p <= '9' ? *p - '0' : (*p | 0x20) - 'a' + 10);
+    }
+    while (p < end && IsOws(*p)) {
+        p++;
+    }
+    if (p == begin || (p < end && *p != ';')) { //";"之后是chunk扩展，忽略
+        m_error = 400;
+        return false;
+    }
+    if (size > maxBodyBytes - m_bodyLen) {
+        m_error = 413;
+        return false;
+    }
+    m_bodyLeft = size;
+    m_state = size == 0 ? TRAILER : CHUNK_DATA;
+    return true;
+}
+
+bool HttpRequest::AppendBody(const char *data, size_t len) {
+    if (m_bodyFd < 0 && m_content.size() + len <= MEMORY_BODY_BYTES) {
+        m_content.append(data, len);
+        m_bodyLen += len;
+        return true;
+    }
+    if (m_bodyFd < 0) {
+        /*超过内存上限，已收到的部分连同这一段转存到临时文件*/
+        m_bodyFd = OpenTempFile(bodyTmpDir);
+        if (m_bodyFd < 0 || !WriteAll(m_bodyFd, m_content.data(), m_content.size())) {
+            LOG_ERROR("Body temp file in %s error:%s", bodyTmpDir.c_str(), strerror(errno));
+            m_error = 500;
+            return false;
+        }
+        std::string().swap(m_content);
+    }
+    if (!WriteAll(m_bodyFd, data, len)) {
+        LOG_ERROR("Body temp file write error:%s", strerror(errno));
+        m_error = 500;
+        return false;
+    }
+    m_bodyLen += len;
+    return true;
+}
+
+bool HttpRequest::FinishBody() {
+    LOG_DEBUG("Body len:%zu, in %s", m_bodyLen, m_bodyFd < 0 ? "memory" : "temp file");
+    if (m_bodyFd >= 0 && GetHeader("Content-Type") == "application/x-www-form-urlencoded") {
+        m_error = 413; //表单只在内存中解析
+        return false;
+    }
     ParsePost();
     m_state = FINISH;
-    LOG_DEBUG("Body:%s, len:%d", line.c_str(), line.size());
+    return true;
 }
 
 void HttpRequest::ParsePath() {
-    if (m_path == "/") {
-        m_path = "/index.html";
-    } else {
-        for (const auto &item : DEFAULT_HTML) {
-            if (item == m_path) {
-                m_path += ".html";
-                break;
-            }
-        }
+    NormalizePath(m_path);
+}
+
+void HttpRequest::NormalizePath(std::string &path) {
+    if (path == "/") {
+        path = "/index.html";
+    } else if (IsDefaultHtml(path)) {
+        path += ".html";
     }
 }
 
@@ -141,12 +482,17 @@ void HttpRequest::ParsePost() {
      *并且对key和value都进行了URL转码, 空格转换为 “+” 加号，特殊符号转换为 ASCII HEX 值*/
     if (m_method == "POST" && m_header["Content-Type"] == "application/x-www-form-urlencoded") {
         ParseFromUrlencoded();
-        if (DEFAULT_HTML_TAG.count(m_path)) {
-            int tag = DEFAULT_HTML_TAG.find(m_path)->second;
+        int tag = DefaultHtmlTag(m_path);
+        if (tag >= 0) {
             LOG_DEBUG("Tag:%d", tag);
             if (tag == 0 || tag == 1) {
                 bool isLogin = (tag == 1);
-                if (UserVerify(m_post["userName"], m_post["passWord"], isLogin)) {
+                int64_t dbStart = NowNs();
+                bool verified = UserVerify(m_post["userName"], m_post["passWord"], isLogin);
+                int64_t dbEnd = NowNs();
+                m_dbNs += dbEnd - dbStart;
+                Tracer::Record(Tracer::Current(), Tracer::DB, dbStart, dbEnd);
+                if (verified) {
                     m_path = "/welcome.html";
                 } else {
                     m_path = "/error.html";
@@ -217,66 +563,9 @@ bool HttpRequest::UserVerify(const std::string &name, const std::string &pwd, bo
     if (name == "" || pwd == "")
         return false;
     LOG_INFO("Verify name:%s pwd:%s", name.c_str(), pwd.c_str());
-    MYSQL *sql;
-    SqlConnRAII(&sql, SqlConnPool::Instance());
-    assert(sql);
-
-    bool flag = false;
-    unsigned int j = 0;
-    char order[256] = {0};
-    MYSQL_FIELD *fields = nullptr;
-    MYSQL_RES *res = nullptr; //查询结果
-    if (!isLogin) {
-        flag = true;
-    }
-    /* 查询用户及密码 */
-    /*用户账号是唯一标识的,如果明知道查询结果只有⼀个,SQL语句中使⽤LIMIT 1会提⾼查询效率*/
-    snprintf(order, 256, "SELECT username, password FROM user WHERE username='%s' LIMIT 1", name.c_str());
-    LOG_DEBUG("%s", order);
-    /*返回0表示查询成功，否则失败*/
-    if (mysql_query(sql, order)) {
-        /*查询失败*/
-        mysql_free_result(res); //一旦完成了对结果集的操作，必须调用mysql_free_result()释放结果集，以防内存泄露
-        return false;
-    }
-    /*对于成功检索了数据的每个查询，必须调用mysql_store_result()或mysql_use_result()*/
-    res = mysql_store_result(sql);
-    /*获取查询结果集的列数目(即有多少列)*/
-    j = mysql_num_fields(res);
-    /*返回结果集中代表字段（列）的对象的数组*/
-    fields = mysql_fetch_fields(res);
-    /*处理执行结果一般放在while循环中，遍历每一行*/
-    while (MYSQL_ROW row = mysql_fetch_row(res)) { //返回执行结果的当前行的数值数组，执行这个函数后，结果指向下一行
-        LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
-        std::string passWord(row[1]);
-        /*登录行为*/
-        if (isLogin) {
-            if (pwd == passWord) {
-                flag = true;
-                LOG_DEBUG("pwd correct!");
-            } else {
-                flag = false;
-                LOG_DEBUG("pwd error!");
-            }
-        } else { /*注册行为*/
-            flag = false;
-            LOG_DEBUG("user used!");
-        }
-    }
-    mysql_free_result(res);
-    /* 注册行为且用户名未被使用*/
-    if (!isLogin && flag == true) {
-        LOG_DEBUG("regirster!");
-        bzero(order, 256);
-        snprintf(order, 256, "INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(), pwd.c_str());
-        LOG_DEBUG("%s", order);
-        if (mysql_query(sql, order)) {
-            LOG_DEBUG("regirster error!");
-            flag = false;
-        } else {
-            LOG_DEBUG("regirster success!");
-        }
+    assert(userStore);
+    if (isLogin) {
+        return userStore->Login(name, pwd);
     }
-    SqlConnPool::Instance()->FreeConn(sql); //将sql连接放回连接池
-    return flag;
+    return userStore->Register(name, pwd);
 }
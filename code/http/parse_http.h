@@ -2,31 +2,73 @@
 #define PARSE_HTTP_H
 #include "../buffer/buffer.h"
 #include "../log/log.h"
-#include "../pool/sql_conn_pool.h"
-#include <mysql/mysql.h>
-#include <regex>
+#include "../store/user_store.h"
 #include <string>
 #include <unordered_map>
-#include <unordered_set>
 
+/*增量解析：每次Parse处理读缓冲区中已到达的部分，状态保存在对象中，下次从断点继续
+ *请求行和请求头要等空行到达后一次解析；消息体按Content-Length或chunked分帧，边到达边从读缓冲区取走，
+ *不超过MEMORY_BODY_BYTES时保存在内存中，否则写入bodyTmpDir下的匿名临时文件，每个连接的内存占用有上限*/
 class HttpRequest
 {
 public:
-    enum PARSE_STATE { REQUEST_LINE = 0, HEADER, CONTENT, FINISH };
-    HttpRequest() {
+    enum PARSE_STATE { REQUEST_LINE = 0, CONTENT, CHUNK_SIZE, CHUNK_DATA, CHUNK_END, TRAILER, FINISH };
+    /*Parse的结果：还需要更多数据、请求完整、请求有误(应答的状态码见ErrorCode)*/
+    enum PARSE_RESULT { NEED_MORE = 0, COMPLETE, INVALID };
+    /*请求行和请求头(含chunked的trailer)的字节数上限，chunk大小行的长度上限*/
+    static const size_t MAX_HEADER_BYTES = 64 * 1024;
+    static const size_t MAX_CHUNK_LINE = 1024;
+    /*不超过该字节数的消息体保存在内存中，表单只能在内存中解析*/
+    static const size_t MEMORY_BODY_BYTES = 64 * 1024;
+
+    HttpRequest() : m_bodyFd(-1) {
         Init();
     };
-    ~HttpRequest() = default;
-    /*初始化*/
+    ~HttpRequest();
+    HttpRequest(const HttpRequest &) = delete;
+    HttpRequest &operator=(const HttpRequest &) = delete;
+    /*初始化，丢弃上一个请求的消息体*/
     void Init();
-    bool Parse(Buffer &buff);
+    PARSE_RESULT Parse(Buffer &buff);
+    PARSE_STATE State() const {
+        return m_state;
+    }
+    /*INVALID时应答的状态码：400格式错误，413消息体过大，501不支持的Transfer-Encoding，500临时文件写入失败*/
+    int ErrorCode() const {
+        return m_error;
+    }
     std::string GetPath() const;
     std::string &GetPath();
     std::string GetMethod() const;
     std::string GetVersion() const;
+    /*请求头的值，名字不区分大小写，不存在时返回空串；Content-Length和Transfer-Encoding出现时不为空*/
+    std::string GetHeader(const std::string &key) const;
     std::string GetPost(const std::string &key) const;
     std::string GetPost(const char *key) const;
     bool IsKeepAlive() const;
+    /*消息体的总字节数；在内存中时为Body()，否则在BodyFd()指向的临时文件中(文件在Init或析构时关闭并删除)*/
+    size_t BodyLen() const {
+        return m_bodyLen;
+    }
+    const std::string &Body() const {
+        return m_content;
+    }
+    int BodyFd() const {
+        return m_bodyFd;
+    }
+    /*本次解析中访问用户存储的耗时(纳秒)*/
+    int64_t DbNs() const {
+        return m_dbNs;
+    }
+    /*将请求路径映射为资源文件路径，如"/"映射为"/index.html"*/
+    static void NormalizePath(std::string &path);
+    /*在还未解析的请求头[begin, end)中查找请求头的值，名字不区分大小写，不存在时返回空串*/
+    static std::string FindHeader(const char *begin, const char *end, const char *key);
+    /*登录和注册使用的用户存储，由Server在启动时设置*/
+    static UserStore *userStore;
+    /*消息体的字节数上限，超过时返回413；较大的消息体写入的临时文件所在目录。由Server在启动时设置*/
+    static size_t maxBodyBytes;
+    static std::string bodyTmpDir;
     /*
     todo
     void HttpConn::ParseFormData() {}
@@ -34,19 +76,45 @@ public:
     */
 
 private:
+    /*请求头的名字不区分大小写(RFC 9110 5.1)，只有大小写不同的名字是同一个字段*/
+    struct HeaderNameHash {
+        size_t operator()(const std::string &name) const;
+    };
+    struct HeaderNameEqual {
+        bool operator()(const std::string &a, const std::string &b) const;
+    };
+
     PARSE_STATE m_state;
     std::string m_method;
     std::string m_path;
     std::string m_version;
-    std::string m_content;
-    std::unordered_map<std::string, std::string> m_header; //存放请求头部
+    std::string m_content; //内存中的消息体
+    std::unordered_map<std::string, std::string, HeaderNameHash, HeaderNameEqual> m_header; //存放请求头部
     std::unordered_map<std::string, std::string> m_post;   //存放POST请求消息键值对
-    static const std::unordered_set<std::string> DEFAULT_HTML; //必须在类外定义，因为容器是模板而不是字面值常量类型
-    static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
+    int64_t m_dbNs;
+    int m_error;
+    size_t m_bodyLeft;     //Content-Length中还未到达的字节数，或当前chunk中还未到达的字节数
+    size_t m_bodyLen;      //已收到的消息体字节数
+    size_t m_trailerBytes; //chunked的trailer已读的字节数
+    int m_bodyFd;          //消息体较大时写入的临时文件，-1表示在内存中
+    /*省略了.html后缀的默认页面，如"/login"*/
+    static bool IsDefaultHtml(const std::string &path);
+    /*需要处理表单的页面：注册为0，登录为1，其他为-1*/
+    static int DefaultHtmlTag(const std::string &path);
 
-    bool ParseRequestLine(const std::string &line);
-    void ParseHeader(const std::string &line);
-    void ParseContent(const std::string &line);
+    /*[begin, end)为请求行，不含CRLF*/
+    bool ParseRequestLine(const char *begin, const char *end);
+    bool ParseHeader(const char *begin, const char *end);
+    /*请求头解析完后，按Transfer-Encoding和Content-Length确定消息体的分帧方式*/
+    bool ParseFraming();
+    /*chunk大小行，形如"1a;ext=v"*/
+    bool ParseChunkSize(const char *begin, const char *end);
+    /*收到一段消息体，超过MEMORY_BODY_BYTES时转存到临时文件*/
+    bool AppendBody(const char *data, size_t len);
+    /*消息体接收完毕，处理表单*/
+    bool FinishBody();
+    PARSE_RESULT Fail(int code);
+    void CloseBody();
     void ParsePath();
     /*处理POST请求*/
     void ParsePost();
@@ -1,42 +1,127 @@
 #include "respond_http.h"
+#include "../metrics/metrics.h"
+#include "../utils/str_hash.h"
+#include "entity_headers.h"
+#include <strings.h>
 
 using namespace std;
 
-const unordered_map<string, string> HttpResponse::SUFFIX_TYPE = {
-    {".html", "text/html"},          {".xml", "text/xml"},          {".xhtml", "application/xhtml+xml"},
-    {".txt", "text/plain"},          {".rtf", "application/rtf"},   {".pdf", "application/pdf"},
-    {".word", "application/nsword"}, {".png", "image/png"},         {".gif", "image/gif"},
-    {".jpg", "image/jpeg"},          {".jpeg", "image/jpeg"},       {".au", "audio/basic"},
-    {".mpeg", "video/mpeg"},         {".mpg", "video/mpeg"},        {".avi", "video/x-msvideo"},
-    {".gz", "application/x-gzip"},   {".tar", "application/x-tar"}, {".css", "text/css "},
-    {".js", "text/javascript "},
-};
-
-const unordered_map<int, string> HttpResponse::CODE_STATUS = {
-    {200, "OK"},
-    {400, "Bad Request"},
-    {403, "Forbidden"},
-    {404, "Not Found"},
-};
-
-const unordered_map<int, string> HttpResponse::CODE_HTML_PATH = {
-    {400, "/400.html"},
-    {403, "/403.html"},
-    {404, "/404.html"},
-};
+namespace {
+
+bool AllDigits(const string &s) {
+    if (s.size() > 18) {
+        return false; //避免溢出
+    }
+    for (char ch : s) {
+        if (ch < '0' || ch > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+string Trim(const string &s) {
+    size_t begin = s.find_first_not_of(" \t");
+    if (begin == string::npos) {
+        return "";
+    }
+    return s.substr(begin, s.find_last_not_of(" \t") - begin + 1);
+}
+
+/*解析HTTP-date(IMF-fixdate)，格式不对时返回-1*/
+time_t ParseHttpDate(const string &value) {
+    struct tm tm = {};
+    const char *end = strptime(value.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (end == nullptr || *end != '\0') {
+        return -1;
+    }
+    return timegm(&tm);
+}
+
+/*Accept-Encoding是否接受该编码：列出且q不为0，或者没有列出而"*"的q不为0*/
+bool Accepts(const string &acceptEncoding, const char *name) {
+    int star = -1;
+    size_t pos = 0;
+    while (pos < acceptEncoding.size()) {
+        size_t end = acceptEncoding.find(',', pos);
+        if (end == string::npos) {
+            end = acceptEncoding.size();
+        }
+        string item = acceptEncoding.substr(pos, end - pos);
+        pos = end + 1;
+        size_t semi = item.find(';');
+        string coding = Trim(item.substr(0, semi));
+        bool accepted = true;
+        if (semi != string::npos) {
+            string param = Trim(item.substr(semi + 1));
+            if (param.compare(0, 2, "q=") == 0) {
+                accepted = atof(param.c_str() + 2) > 0;
+            }
+        }
+        if (strcasecmp(coding.c_str(), name) == 0) {
+            return accepted;
+        }
+        if (coding == "*") {
+            star = accepted ? 1 : 0;
+        }
+    }
+    return star == 1;
+}
+
+} // namespace
+
+unordered_map<string, string> HttpResponse::cacheControl;
+
+const char *HttpResponse::StatusLine(int code) {
+    switch (code) {
+        case 200:
+            return "HTTP/1.1 200 OK\r\n";
+        case 206:
+            return "HTTP/1.1 206 Partial Content\r\n";
+        case 304:
+            return "HTTP/1.1 304 Not Modified\r\n";
+        case 400:
+            return "HTTP/1.1 400 Bad Request\r\n";
+        case 403:
+            return "HTTP/1.1 403 Forbidden\r\n";
+        case 404:
+            return "HTTP/1.1 404 Not Found\r\n";
+        case 413:
+            return "HTTP/1.1 413 Payload Too Large\r\n";
+        case 416:
+            return "HTTP/1.1 416 Range Not Satisfiable\r\n";
+        case 500:
+            return "HTTP/1.1 500 Internal Server Error\r\n";
+        case 501:
+            return "HTTP/1.1 501 Not Implemented\r\n";
+        default:
+            return nullptr;
+    }
+}
+
+const char *HttpResponse::ErrorPage(int code) {
+    switch (code) {
+        case 400:
+            return "/400.html";
+        case 403:
+            return "/403.html";
+        case 404:
+            return "/404.html";
+        default:
+            return nullptr;
+    }
+}
 
 void HttpResponse::WriteReponseLine(Buffer &buff) {
-    string status;
-    if (CODE_STATUS.count(m_code) == 1) {
-        status = CODE_STATUS.find(m_code)->second;
-    } else {
+    const char *line = StatusLine(m_code);
+    if (line == nullptr) {
         m_code = 400;
-        status = CODE_STATUS.find(m_code)->second;
+        line = StatusLine(m_code);
     }
-    buff.Append("HTTP/1.1 " + to_string(m_code) + " " + status + "\r\n");
+    buff.Append(line, strlen(line));
 }
 
-void HttpResponse::WriteResponseHeader(Buffer &buff) {
+void HttpResponse::WriteConnection(Buffer &buff) {
     buff.Append("Connection: ");
     if (m_isKeepAlive) {
         buff.Append("keep-alive\r\n");
@@ -44,45 +129,430 @@ void HttpResponse::WriteResponseHeader(Buffer &buff) {
     } else {
         buff.Append("close\r\n");
     }
-    buff.Append("Content-type: " + GetFileType() + "\r\n");
 }
 
-void HttpResponse::WriteReponseContent(Buffer &buff) {
-    int srcFd = open((m_srcDir + m_path).data(), O_RDONLY);
-    if (srcFd < 0) {
-        WriteErrorContent(buff, "File NotFound!");
-        return;
+void HttpResponse::WriteResponseHeader(Buffer &buff) {
+    WriteConnection(buff);
+    if (m_code == 200 || m_code == 206 || m_code == 304) {
+        WriteValidators(buff);
     }
-    LOG_DEBUG("file path %s", (m_srcDir + m_path).data());
-    /* 将文件映射到内存提高文件的访问速度
-     *MAP_PRIVATE 建立一个写入时拷贝的私有映射
-     *仅仅只是对文件副本进行读写*/
-    int *mmRet = (int *)mmap(0, m_fileStat.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if (*mmRet == -1) {
-        WriteErrorContent(buff, "File NotFound!");
+    if (m_code == 304) {
+        return; //没有消息体，也不带Content-length
+    }
+    if (m_encoding != Compressor::IDENTITY) {
+        buff.Append(string("Content-Encoding: ") + Compressor::Name(m_encoding) + "\r\n");
+    }
+    /*即时压缩的内容长度事先未知，不支持Range*/
+    if ((m_code == 200 || m_code == 206) && !m_onTheFly) {
+        buff.Append("Accept-Ranges: bytes\r\n");
+    }
+    if (m_ranges.size() > 1) {
+        buff.Append("Content-type: multipart/byteranges; boundary=" + m_boundary + "\r\n");
+    } else if (m_code >= 400 && !ErrorPage(m_code)) {
+        buff.Append("Content-type: text/html\r\n"); //WriteErrorContent生成的页面
+        if (m_code == 416) {
+            buff.Append("Content-Range: bytes */" + to_string(m_fileStat.st_size) + "\r\n");
+        }
+    } else {
+        buff.Append(string("Content-type: ") + GetFileType() + "\r\n");
+    }
+}
+
+void HttpResponse::WriteHeaderBlock(Buffer &buff) {
+    /*响应头由状态码、是否长连接、编码和文件决定，文件的变化由stat校验*/
+    char tag[] = {'|',
+                  static_cast<char>('0' + m_code / 100),
+                  static_cast<char>('0' + m_code / 10 % 10),
+                  static_cast<char>('0' + m_code % 10),
+                  m_isKeepAlive ? 'k' : 'c',
+                  static_cast<char>('0' + m_encoding),
+                  StreamEncoded() ? 'c' : m_onTheFly ? 'f' : 's'};
+    if (m_code == 200 && !m_onTheFly) {
+        /*资源包中有打包时生成的实体头部，只需补上响应行和随配置、请求变化的字段*/
+        size_t len;
+        const char *entity = AssetPack::Instance()->HeaderBlock(m_filePath, m_encoding != Compressor::IDENTITY, len);
+        if (entity) {
+            WriteReponseLine(buff);
+            WriteConnection(buff);
+            WriteCacheControl(buff);
+            buff.Append(entity, len);
+            buff.Append(DateHeader());
+            buff.Append("\r\n", 2);
+            return;
+        }
+    }
+    string key = m_filePath;
+    key.append(tag, sizeof(tag));
+    std::shared_ptr<const FileCache::Entry> block = FileCache::Headers()->Find(key, m_fileStat);
+    if (!block) {
+        Buffer head(256);
+        WriteReponseLine(head);
+        WriteResponseHeader(head);
+        if (m_code == 304) {
+            //没有消息体，也不带Content-length
+        } else if (StreamEncoded()) {
+            head.Append("Transfer-Encoding: chunked\r\n"); //压缩后的长度事先未知
+        } else {
+            head.Append("Content-length: " + to_string(BodyLen()) + "\r\n");
+        }
+        std::shared_ptr<FileCache::Entry> entry(new FileCache::Entry());
+        entry->data = head.RetrieveAllToStr();
+        entry->ino = m_fileStat.st_ino;
+        entry->size = m_fileStat.st_size;
+        entry->mtime = m_fileStat.st_mtim;
+        FileCache::Headers()->Insert(key, entry);
+        block = entry;
+    }
+    buff.Append(block->data);
+    buff.Append(DateHeader());
+    buff.Append("\r\n", 2);
+}
+
+const string &HttpResponse::DateHeader() {
+    static thread_local time_t last = 0;
+    static thread_local string header;
+    time_t now = time(nullptr);
+    if (now != last) {
+        last = now;
+        header = "Date: " + HttpDate(now) + "\r\n";
+    }
+    return header;
+}
+
+bool HttpResponse::LoadContent() {
+    if (m_encoded) {
+        m_file = std::shared_ptr<const char>(m_encoded, m_encoded->data.data());
+        return true;
+    }
+    if (AssetPack::Instance()->Active()) {
+        m_file = AssetPack::Instance()->Data(m_filePath);
+        return m_file != nullptr;
+    }
+    std::shared_ptr<const FileCache::Entry> cached = FileCache::Instance()->Get(m_filePath, m_fileStat, true);
+    if (cached) {
+        m_file = std::shared_ptr<const char>(cached, cached->data.data()); //与缓存项共享所有权
+        return true;
+    }
+    return MapFile();
+}
+
+bool HttpResponse::StatFile(const string &file, struct stat &st) {
+    AssetPack *pack = AssetPack::Instance();
+    if (pack->Active()) {
+        return pack->Stat(file, st);
+    }
+    return stat(file.c_str(), &st) == 0;
+}
+
+size_t HttpResponse::BodyLen() const {
+    return m_encoded ? m_encoded->data.size() : m_fileStat.st_size;
+}
+
+void HttpResponse::WriteRangeContent(Buffer &buff) {
+    string size = to_string(m_fileStat.st_size);
+    if (m_ranges.size() == 1) {
+        const ByteRange &r = m_ranges[0];
+        buff.Append("Content-Range: bytes " + to_string(r.first) + "-" + to_string(r.last) + "/" + size + "\r\n");
+        buff.Append(DateHeader());
+        buff.Append("Content-length: " + to_string(r.last - r.first + 1) + "\r\n\r\n");
+        AddFilePart(buff, r.first, r.last - r.first + 1);
         return;
     }
-    m_file = (char *)mmRet;
-    close(srcFd);
-    buff.Append("Content-length: " + to_string(m_fileStat.st_size) + "\r\n\r\n");
+    /*multipart/byteranges：每段以分隔行和该段的Content-Type、Content-Range开头，先算出总长度*/
+    vector<string> heads;
+    string type = GetFileType();
+    size_t total = 0;
+    for (const ByteRange &r : m_ranges) {
+        heads.push_back("\r\n--" + m_boundary + "\r\nContent-Type: " + type + "\r\nContent-Range: bytes " +
+                        to_string(r.first) + "-" + to_string(r.last) + "/" + size + "\r\n\r\n");
+        total += heads.back().size() + (r.last - r.first + 1);
+    }
+    string tail = "\r\n--" + m_boundary + "--\r\n";
+    total += tail.size();
+    buff.Append(DateHeader());
+    buff.Append("Content-length: " + to_string(total) + "\r\n\r\n");
+    for (size_t i = 0; i < m_ranges.size(); i++) {
+        buff.Append(heads[i]);
+        AddFilePart(buff, m_ranges[i].first, m_ranges[i].last - m_ranges[i].first + 1);
+    }
+    buff.Append(tail);
+}
+
+void HttpResponse::WriteValidators(Buffer &buff) {
+    buff.Append("ETag: " + ETag(m_fileStat, m_onTheFly ? m_encoding : Compressor::IDENTITY) + "\r\n");
+    buff.Append("Last-Modified: " + HttpDate(m_fileStat.st_mtime) + "\r\n");
+    if (m_vary) {
+        buff.Append("Vary: Accept-Encoding\r\n");
+    }
+    WriteCacheControl(buff);
 }
 
-string HttpResponse::GetFileType() {
+void HttpResponse::WriteCacheControl(Buffer &buff) {
+    if (cacheControl.empty()) {
+        return;
+    }
     string::size_type idx = m_path.find_last_of('.');
-    if (idx == string::npos) {
-        return "text/plain";
+    auto it = idx == string::npos ? cacheControl.end() : cacheControl.find(m_path.substr(idx));
+    if (it == cacheControl.end()) {
+        it = cacheControl.find("*");
     }
-    string suffix = m_path.substr(idx);
-    if (SUFFIX_TYPE.count(suffix) == 1) {
-        return SUFFIX_TYPE.find(suffix)->second;
+    if (it != cacheControl.end()) {
+        buff.Append("Cache-Control: " + it->second + "\r\n");
     }
-    return "text/plain";
+}
+
+bool HttpResponse::IfRangeMatches() const {
+    if (m_ifRange.empty()) {
+        return true;
+    }
+    /*If-Range要求强比较：ETag完全一致，或者日期与Last-Modified一致*/
+    if (m_ifRange[0] == '"') {
+        return m_ifRange == ETag(m_fileStat);
+    }
+    return ParseHttpDate(m_ifRange) == m_fileStat.st_mtime;
+}
+
+string HttpResponse::ETag(const struct stat &st, Compressor::Encoding encoding) {
+    return EntityTag(static_cast<unsigned long>(st.st_ino), static_cast<unsigned long>(st.st_size),
+                     static_cast<unsigned long long>(st.st_mtim.tv_sec) * 1000000000ULL + st.st_mtim.tv_nsec,
+                     encoding == Compressor::IDENTITY ? "" : Compressor::Name(encoding));
+}
+
+bool HttpResponse::NotModified(const string &etag, time_t mtime, const string &ifNoneMatch,
+                               const string &ifModifiedSince) {
+    if (!ifNoneMatch.empty()) {
+        /*弱比较：忽略W/前缀，列表中任意一个一致即可*/
+        size_t pos = 0;
+        while (pos <= ifNoneMatch.size()) {
+            size_t end = ifNoneMatch.find(',', pos);
+            if (end == string::npos) {
+                end = ifNoneMatch.size();
+            }
+            string tag = Trim(ifNoneMatch.substr(pos, end - pos));
+            pos = end + 1;
+            if (tag.compare(0, 2, "W/") == 0) {
+                tag = tag.substr(2);
+            }
+            if (tag == "*" || tag == etag) {
+                return true;
+            }
+        }
+        return false;
+    }
+    if (!ifModifiedSince.empty()) {
+        time_t since = ParseHttpDate(ifModifiedSince);
+        return since >= 0 && mtime <= since;
+    }
+    return false;
+}
+
+bool HttpResponse::PrepareEncoded() {
+    string key = m_filePath + ":" + Compressor::Name(m_encoding);
+    m_encoded = FileCache::Encoded()->Find(key, m_fileStat);
+    if (m_encoded) {
+        return true;
+    }
+    /*原文件内容：小文件缓存中有就不再读磁盘*/
+    std::shared_ptr<const FileCache::Entry> cached = FileCache::Instance()->Get(m_filePath, m_fileStat, true);
+    std::shared_ptr<const char> data;
+    if (cached) {
+        data = std::shared_ptr<const char>(cached, cached->data.data());
+    } else {
+        int fd = open(m_filePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        size_t len = m_fileStat.st_size;
+        void *addr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        data = std::shared_ptr<const char>(static_cast<const char *>(addr),
+                                           [len](const char *p) { munmap(const_cast<char *>(p), len); });
+    }
+    std::shared_ptr<FileCache::Entry> entry(new FileCache::Entry());
+    if (!Compressor::Compress(m_encoding, data.get(), m_fileStat.st_size, entry->data)) {
+        return false;
+    }
+    Metrics::Add(Metrics::COMPRESSIONS);
+    entry->ino = m_fileStat.st_ino;
+    entry->size = m_fileStat.st_size;
+    entry->mtime = m_fileStat.st_mtim;
+    FileCache::Encoded()->Insert(key, entry);
+    m_encoded = entry;
+    return true;
+}
+
+bool HttpResponse::StreamEncoded() const {
+    return m_onTheFly && static_cast<size_t>(m_fileStat.st_size) > FileCache::Encoded()->MaxFileSize();
+}
+
+HttpResponse::ChunkedBody::ChunkedBody(std::shared_ptr<const char> file, size_t size, Compressor::Encoding encoding)
+    : m_file(file), m_size(size), m_offset(0), m_done(false), m_failed(false), m_stream(encoding) {}
+
+bool HttpResponse::ChunkedBody::Next(std::shared_ptr<const char> &data, size_t &len) {
+    if (m_done) {
+        return false;
+    }
+    std::shared_ptr<string> chunk = std::make_shared<string>();
+    chunk->reserve(HEAD_RESERVE + MIN_CHUNK + INPUT_SLICE + 64);
+    chunk->resize(HEAD_RESERVE);
+    /*压缩器会缓冲输入，一段输入不一定有输出，攒够MIN_CHUNK或者输入结束再发送*/
+    while (chunk->size() - HEAD_RESERVE < MIN_CHUNK && m_offset < m_size) {
+        size_t n = std::min(INPUT_SLICE, m_size - m_offset);
+        if (!m_stream.Write(m_file.get() + m_offset, n, m_offset + n == m_size, *chunk)) {
+            m_done = m_failed = true;
+            m_file.reset();
+            return false;
+        }
+        m_offset += n;
+    }
+    size_t payload = chunk->size() - HEAD_RESERVE;
+    size_t start = HEAD_RESERVE;
+    if (payload > 0) {
+        char head[HEAD_RESERVE + 1];
+        int headLen = snprintf(head, sizeof(head), "%zx\r\n", payload);
+        start -= headLen;
+        memcpy(&(*chunk)[start], head, headLen);
+        chunk->append("\r\n");
+    }
+    if (m_offset == m_size) {
+        chunk->append("0\r\n\r\n"); //最后一个chunk，没有trailer
+        m_done = true;
+        m_file.reset(); //尽早释放文件映射
+    }
+    data = std::shared_ptr<const char>(chunk, chunk->data() + start);
+    len = chunk->size() - start;
+    return true;
+}
+
+Compressor::Encoding HttpResponse::Negotiate(const string &file, const struct stat &st, const string &acceptEncoding,
+                                             bool chunked, struct stat &sidecar, bool &vary) {
+    sidecar = {0};
+    vary = Compressible(file);
+    /*太小的文件压缩不划算，也不去找预压缩文件，省下两次stat*/
+    if (!vary || acceptEncoding.empty() || st.st_size < MIN_COMPRESS_SIZE) {
+        return Compressor::IDENTITY;
+    }
+    const Compressor::Encoding PREFERRED[] = {Compressor::BROTLI, Compressor::GZIP};
+    Compressor::Encoding onTheFly = Compressor::IDENTITY;
+    for (Compressor::Encoding encoding : PREFERRED) {
+        if (!Accepts(acceptEncoding, Compressor::Name(encoding))) {
+            continue;
+        }
+        /*预压缩文件比原文件旧时视为过期，不使用*/
+        struct stat st2;
+        if (StatFile(file + Compressor::Suffix(encoding), st2) && S_ISREG(st2.st_mode) &&
+            (st2.st_mode & S_IROTH) && st2.st_mtime >= st.st_mtime) {
+            sidecar = st2;
+            return encoding;
+        }
+        if (onTheFly == Compressor::IDENTITY && Compressor::Supported(encoding)) {
+            onTheFly = encoding;
+        }
+    }
+    /*资源包在打包时已经生成了值得压缩的文件的压缩条目；压缩缓存容量为0表示只使用预压缩文件，
+     *否则每个请求都要重新压缩一遍(结果放不进缓存)，chunked流式压缩同样不做*/
+    if (AssetPack::Instance()->Active() || FileCache::Encoded()->Capacity() == 0 ||
+        (!chunked && static_cast<size_t>(st.st_size) > FileCache::Encoded()->MaxFileSize())) {
+        return Compressor::IDENTITY;
+    }
+    return onTheFly;
+}
+
+void HttpResponse::AddFilePart(Buffer &buff, size_t offset, size_t len) {
+    m_parts.push_back({buff.ReadableBytes() - m_mark, offset, len});
+    m_mark = buff.ReadableBytes();
+}
+
+int HttpResponse::ParseRanges(const string &value, off_t size, vector<ByteRange> &ranges) {
+    if (value.compare(0, 6, "bytes=") != 0) {
+        return -1;
+    }
+    size_t pos = 6;
+    size_t specs = 0;
+    while (pos <= value.size()) {
+        size_t end = value.find(',', pos);
+        if (end == string::npos) {
+            end = value.size();
+        }
+        string spec = Trim(value.substr(pos, end - pos));
+        pos = end + 1;
+        size_t dash = spec.find('-');
+        if (++specs > MAX_RANGES || dash == string::npos) {
+            return -1;
+        }
+        string first = spec.substr(0, dash);
+        string last = spec.substr(dash + 1);
+        if (!AllDigits(first) || !AllDigits(last) || (first.empty() && last.empty())) {
+            return -1;
+        }
+        ByteRange r;
+        if (first.empty()) {
+            /*bytes=-N：最后N个字节*/
+            off_t n = strtoll(last.c_str(), nullptr, 10);
+            if (n == 0 || size == 0) {
+                continue; //不可满足
+            }
+            r.first = n < size ? size - n : 0;
+            r.last = size - 1;
+        } else {
+            r.first = strtoll(first.c_str(), nullptr, 10);
+            r.last = last.empty() ? size - 1 : strtoll(last.c_str(), nullptr, 10);
+            if (!last.empty() && r.last < r.first) {
+                return -1; //格式错误，整个Range头无效
+            }
+            if (r.first >= size) {
+                continue; //不可满足
+            }
+            r.last = r.last < size - 1 ? r.last : size - 1;
+        }
+        ranges.push_back(r);
+    }
+    return ranges.size();
+}
+
+bool HttpResponse::MapFile() {
+    int srcFd = open(m_filePath.data(), O_RDONLY);
+    if (srcFd < 0) {
+        return false;
+    }
+    LOG_DEBUG("file path %s", m_filePath.data());
+    /* 将文件映射到内存提高文件的访问速度
+     *MAP_PRIVATE 建立一个写入时拷贝的私有映射
+     *仅仅只是对文件副本进行读写*/
+    size_t len = m_fileStat.st_size;
+    void *mmRet = mmap(0, len, PROT_READ, MAP_PRIVATE, srcFd, 0);
+    close(srcFd);
+    if (mmRet == MAP_FAILED) {
+        return false;
+    }
+    /*私有映射没有文件读的预读窗口，按访问方式提示内核：整个文件顺序发送时积极预读并及早回收，
+     *范围请求只预读请求的部分*/
+    if (m_ranges.empty() && len >= SEQUENTIAL_SIZE) {
+        madvise(mmRet, len, MADV_SEQUENTIAL);
+    }
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    for (const ByteRange &r : m_ranges) {
+        size_t begin = r.first / pageSize * pageSize;
+        madvise(static_cast<char *>(mmRet) + begin, r.last + 1 - begin, MADV_WILLNEED);
+    }
+    /*映射随最后一个持有者释放，响应排队发送期间HttpResponse可以处理下一个请求*/
+    m_file = std::shared_ptr<const char>(static_cast<const char *>(mmRet),
+                                         [len](const char *addr) { munmap(const_cast<char *>(addr), len); });
+    return true;
+}
+
+const char *HttpResponse::GetFileType() {
+    return FileType(m_path);
 }
 
 void HttpResponse::GetErrorHtml() {
-    if (CODE_HTML_PATH.count(m_code) == 1) {
-        m_path = CODE_HTML_PATH.find(m_code)->second;
-        stat((m_srcDir + m_path).data(), &m_fileStat);
+    const char *page = ErrorPage(m_code);
+    if (page) {
+        m_path = page;
+        StatFile(m_srcDir + m_path, m_fileStat);
     }
 }
 
@@ -90,7 +560,6 @@ HttpResponse::HttpResponse() {
     m_code = -1;
     m_path = m_srcDir = "";
     m_isKeepAlive = false;
-    m_file = nullptr;
     m_fileStat = {0};
 }
 
@@ -108,17 +577,30 @@ void HttpResponse::Init(const std::string &srcDIR, const std::string &path, bool
     m_path = path;
     m_srcDir = srcDIR;
     m_fileStat = {0};
+    m_range.clear();
+    m_ifRange.clear();
+    m_ifNoneMatch.clear();
+    m_ifModifiedSince.clear();
+    m_acceptEncoding.clear();
+    m_encoding = Compressor::IDENTITY;
+    m_onTheFly = false;
+    m_acceptChunked = false;
+    m_chunked.reset();
+    m_vary = false;
+    m_filePath.clear();
+    m_encoded.reset();
+    m_ranges.clear();
+    m_parts.clear();
 }
 
 void HttpResponse::UnmapFile() {
-    if (m_file) {
-        munmap(m_file, m_fileStat.st_size);
-        m_file = nullptr;
-    }
+    m_file.reset();
 }
 
 void HttpResponse::Respond(Buffer &buff) {
-    if (stat((m_srcDir + m_path).data(), &m_fileStat) < 0 || S_ISDIR(m_fileStat.st_mode)) {
+    if (m_code >= 400) {
+        //请求本身有误，不查找请求的文件
+    } else if (!StatFile(m_srcDir + m_path, m_fileStat) || S_ISDIR(m_fileStat.st_mode)) {
         m_code = 404; //没有该资源
 
     } else if (!(m_fileStat.st_mode & S_IROTH)) {
@@ -127,9 +609,66 @@ void HttpResponse::Respond(Buffer &buff) {
         m_code = 200; //请求成功
     }
     GetErrorHtml();
-    WriteReponseLine(buff);
-    WriteResponseHeader(buff);
-    WriteReponseContent(buff);
+    m_mark = buff.ReadableBytes();
+    m_filePath = m_srcDir + m_path;
+    if (m_code == 200) {
+        struct stat sidecar;
+        m_encoding = Negotiate(m_filePath, m_fileStat, m_acceptEncoding, m_acceptChunked, sidecar, m_vary);
+        if (sidecar.st_ino != 0) {
+            m_fileStat = sidecar; //发送预压缩文件，ETag、Last-Modified和Range都以它为准
+            m_filePath += Compressor::Suffix(m_encoding);
+        } else {
+            m_onTheFly = m_encoding != Compressor::IDENTITY;
+        }
+        if (NotModified(ETag(m_fileStat, m_onTheFly ? m_encoding : Compressor::IDENTITY), m_fileStat.st_mtime,
+                        m_ifNoneMatch, m_ifModifiedSince)) {
+            m_code = 304;
+        } else if (m_onTheFly && !StreamEncoded() && !PrepareEncoded()) {
+            m_encoding = Compressor::IDENTITY; //压缩失败，发送原文件
+            m_onTheFly = false;
+        }
+    }
+    if (m_code == 200 && !m_range.empty() && !m_onTheFly && IfRangeMatches()) {
+        int n = ParseRanges(m_range, m_fileStat.st_size, m_ranges);
+        if (n == 0) {
+            m_code = 416;
+        } else if (n > 0) {
+            m_code = 206;
+            if (n > 1) {
+                static std::atomic<uint64_t> boundary(static_cast<uint64_t>(time(nullptr)) << 20);
+                m_boundary = to_string(boundary.fetch_add(1, std::memory_order_relaxed));
+            }
+        } else {
+            m_ranges.clear();
+        }
+    }
+    if (m_code >= 400 && !ErrorPage(m_code)) {
+        WriteReponseLine(buff);
+        WriteResponseHeader(buff);
+        WriteErrorContent(buff, m_code == 416 ? "Requested range not satisfiable" : "");
+    } else if (m_code != 304 && !LoadContent()) {
+        WriteReponseLine(buff);
+        WriteResponseHeader(buff);
+        WriteErrorContent(buff, "File NotFound!");
+    } else if (m_code == 206) {
+        WriteReponseLine(buff);
+        WriteResponseHeader(buff);
+        WriteRangeContent(buff);
+    } else {
+        WriteHeaderBlock(buff);
+        if (m_code == 304) {
+            //没有消息体
+        } else if (StreamEncoded()) {
+            m_chunked = std::make_shared<ChunkedBody>(m_file, m_fileStat.st_size, m_encoding);
+            Metrics::Add(Metrics::COMPRESSIONS);
+        } else {
+            AddFilePart(buff, 0, BodyLen());
+        }
+    }
+    if (buff.ReadableBytes() > m_mark) {
+        m_parts.push_back({buff.ReadableBytes() - m_mark, 0, 0});
+        m_mark = buff.ReadableBytes();
+    }
 }
 
 void HttpResponse::WriteErrorContent(Buffer &buff, string message) {
@@ -137,8 +676,9 @@ void HttpResponse::WriteErrorContent(Buffer &buff, string message) {
     string status;
     body += "<html><title>Error</title>";
     body += "<body bgcolor=\"ffffff\">";
-    if (CODE_STATUS.count(m_code) == 1) {
-        status = CODE_STATUS.find(m_code)->second;
+    const char *line = StatusLine(m_code);
+    if (line) {
+        status.assign(line + 13, strlen(line) - 15); //去掉"HTTP/1.1 200 "和CRLF
     } else {
         status = "Bad Request";
     }
@@ -146,11 +686,59 @@ void HttpResponse::WriteErrorContent(Buffer &buff, string message) {
     body += "<p>" + message + "</p>";
     body += "<hr><em>MyWebServer</em></body></html>";
 
+    buff.Append(DateHeader());
     buff.Append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
     buff.Append(body);
 }
 
-char *HttpResponse::File() {
+bool HttpResponse::ServableFromCache(const std::string &srcDir, const std::string &path, size_t maxBytes,
+                                     const std::string &ifNoneMatch, const std::string &ifModifiedSince,
+                                     const std::string &acceptEncoding, bool acceptChunked) {
+    /*与Respond中的判断保持一致*/
+    struct stat st;
+    std::string file = srcDir + path;
+    int code = 200;
+    if (!StatFile(file, st) || S_ISDIR(st.st_mode)) {
+        code = 404;
+    } else if (!(st.st_mode & S_IROTH)) {
+        code = 403;
+    }
+    if (code == 200) {
+        /*与Respond相同的协商，压缩的内容也必须已在缓存中*/
+        struct stat sidecar;
+        bool vary;
+        Compressor::Encoding encoding = Negotiate(file, st, acceptEncoding, acceptChunked, sidecar, vary);
+        bool onTheFly = encoding != Compressor::IDENTITY && sidecar.st_ino == 0;
+        if (sidecar.st_ino != 0) {
+            st = sidecar;
+            file += Compressor::Suffix(encoding);
+        }
+        if (NotModified(ETag(st, onTheFly ? encoding : Compressor::IDENTITY), st.st_mtime, ifNoneMatch,
+                        ifModifiedSince)) {
+            return true; //304只需要stat
+        }
+        if (onTheFly) {
+            /*流式压缩的大文件不在缓存中，Find总是返回nullptr*/
+            std::shared_ptr<const FileCache::Entry> entry =
+                FileCache::Encoded()->Find(file + ":" + Compressor::Name(encoding), st);
+            return entry && entry->data.size() <= maxBytes;
+        }
+    }
+    if (code != 200) {
+        file = srcDir + ErrorPage(code);
+        if (!StatFile(file, st)) {
+            return false;
+        }
+    }
+    return static_cast<size_t>(st.st_size) <= maxBytes &&
+           (AssetPack::Instance()->Active() || FileCache::Instance()->Get(file, st, false) != nullptr);
+}
+
+const char *HttpResponse::File() const {
+    return m_file.get();
+}
+
+std::shared_ptr<const char> HttpResponse::FileHolder() const {
     return m_file;
 }
 
@@ -2,42 +2,171 @@
 #define RESPOND_HTTP_H
 #include "../buffer/buffer.h"
 #include "../log/log.h"
+#include "asset_pack.h"
+#include "compressor.h"
+#include "file_cache.h"
+#include <atomic>
+#include <ctime>
 #include <fcntl.h>    // open
 #include <sys/mman.h> // mmap, munmap
 #include <sys/stat.h> // stat
 #include <unistd.h>   // close
 #include <unordered_map>
+#include <vector>
 class HttpResponse
 {
+public:
+    /*响应的一段：先发写缓冲区中的buffLen字节，再发文件中从fileOffset开始的fileLen字节*/
+    struct BodyPart {
+        size_t buffLen;
+        size_t fileOffset;
+        size_t fileLen;
+    };
+    /*chunked响应的消息体：超过即时压缩缓存上限的文件不预先整个压缩，发送时每次压缩下一段，
+     *连同chunk的长度行一起交给HttpConn，每个连接同时只持有一段压缩数据*/
+    class ChunkedBody
+    {
+    public:
+        ChunkedBody(std::shared_ptr<const char> file, size_t size, Compressor::Encoding encoding);
+        /*取得下一个chunk，最后一个chunk之后附带结束标记；已经结束或压缩失败时返回false*/
+        bool Next(std::shared_ptr<const char> &data, size_t &len);
+        /*压缩失败，消息体不完整，连接不能再复用*/
+        bool Failed() const {
+            return m_failed;
+        }
+
+    private:
+        static const size_t INPUT_SLICE = 64 * 1024; //每次压缩的输入字节数
+        static const size_t MIN_CHUNK = 16 * 1024;   //压缩结果攒到该字节数才作为一个chunk
+        static const size_t HEAD_RESERVE = 18;       //长度行预留的位置，16位十六进制加CRLF
+        std::shared_ptr<const char> m_file;
+        size_t m_size;
+        size_t m_offset;
+        bool m_done;
+        bool m_failed;
+        Compressor::Stream m_stream;
+    };
+
 private:
+    /*Range请求中的一个闭区间*/
+    struct ByteRange {
+        off_t first;
+        off_t last;
+    };
+    /*一个请求最多的范围数，超过时忽略Range返回整个文件，避免大量重叠范围放大流量*/
+    static const size_t MAX_RANGES = 16;
+    /*小于该字节数的文件压缩后省不了多少，不压缩*/
+    static const off_t MIN_COMPRESS_SIZE = 256;
+    /*不小于该字节数的文件整个发送时，映射以MADV_SEQUENTIAL提示内核*/
+    static const size_t SEQUENTIAL_SIZE = 128 * 1024;
     int m_code;
     bool m_isKeepAlive;
     std::string m_path;
     std::string m_srcDir;
-    char *m_file;           //目标文件映射到内存的地址
+    std::shared_ptr<const char> m_file; //目标文件映射到内存的地址，或指向缓存的内容；释放时解除映射
+    std::string m_range;                //请求的Range头，为空表示请求整个文件
+    std::string m_ifRange;              //If-Range头，与当前的ETag或Last-Modified一致时Range才生效
+    std::string m_ifNoneMatch;
+    std::string m_ifModifiedSince;
+    std::string m_acceptEncoding;
+    Compressor::Encoding m_encoding; //响应的Content-Encoding
+    bool m_onTheFly;                 //没有预压缩文件，即时压缩(结果在FileCache::Encoded()中，或以chunked流式发送)
+    bool m_acceptChunked;            //客户端能接收chunked响应(HTTP/1.1)
+    std::shared_ptr<ChunkedBody> m_chunked;
+    bool m_vary;                     //响应随Accept-Encoding变化
+    std::string m_filePath;          //实际发送的文件，使用预压缩文件时为.gz/.br文件
+    std::shared_ptr<const FileCache::Entry> m_encoded;
+    std::vector<ByteRange> m_ranges;    //可满足的范围，多于一个时以multipart/byteranges返回
+    std::string m_boundary;
+    std::vector<BodyPart> m_parts;
+    size_t m_mark; //写缓冲区中已经记入m_parts的位置
     struct stat m_fileStat; //目标文件状态                                             // 文件属性
-    static const std::unordered_map<std::string, std::string> SUFFIX_TYPE; //请求文件后缀路径映射
-    static const std::unordered_map<int, std::string> CODE_STATUS;         //响应状态码
-    static const std::unordered_map<int, std::string> CODE_HTML_PATH;      //响应状态码对应的HTML页面路径
+    /*以下查找表都是switch，不分配内存；未知的输入返回nullptr。文件类型的查找表见entity_headers.h*/
+    static const char *StatusLine(int code); //响应行，如"HTTP/1.1 200 OK\r\n"
+    static const char *ErrorPage(int code);  //响应状态码对应的HTML页面路径
 
     void WriteReponseLine(Buffer &buff);    //写响应行
-    void WriteResponseHeader(Buffer &buff); //写响应头
-    void WriteReponseContent(Buffer &buff); //写响应消息
-    std::string GetFileType();              //判断请求的文件类型
+    void WriteResponseHeader(Buffer &buff); //写响应头，不含Date
+    void WriteConnection(Buffer &buff);     //写Connection及keep-alive
+    /*写整个响应头(响应行、各字段、Content-length)，以文件的stat校验缓存在FileCache::Headers()中，
+     *命中时只需一次拷贝，之后补上每个请求不同的Date和空行*/
+    void WriteHeaderBlock(Buffer &buff);
+    const char *GetFileType();              //判断请求的文件类型
     void GetErrorHtml();                    //请求失败，返回给客户的HTML文件
+    bool LoadContent();                     //取得要发送的内容：压缩结果、缓存或映射文件
+    bool MapFile();                         //将目标文件映射到内存
+    size_t BodyLen() const;
+    /*启用资源包时从包中取得文件状态，否则stat；失败时返回false*/
+    static bool StatFile(const std::string &file, struct stat &st);
+    /*"Date: ...\r\n"，每个线程每秒格式化一次*/
+    static const std::string &DateHeader();
+    void WriteRangeContent(Buffer &buff);   //写206响应的消息
+    void AddFilePart(Buffer &buff, size_t offset, size_t len);
+    void WriteValidators(Buffer &buff); //写ETag、Last-Modified、Vary和Cache-Control
+    void WriteCacheControl(Buffer &buff);
+    bool IfRangeMatches() const;
+    bool PrepareEncoded(); //取得或生成即时压缩的内容，失败时返回false
+    /*强ETag，由inode、大小和修改时间(纳秒)生成，文件被替换或修改后随之改变；即时压缩的内容加上编码后缀*/
+    static std::string ETag(const struct stat &st, Compressor::Encoding encoding = Compressor::IDENTITY);
+    /*条件请求的判断：有If-None-Match时只看它，否则看If-Modified-Since*/
+    static bool NotModified(const std::string &etag, time_t mtime, const std::string &ifNoneMatch,
+                            const std::string &ifModifiedSince);
+    /*按Accept-Encoding选择编码：优先br，其次gzip；有不旧于原文件的预压缩文件时sidecar为它的stat，
+     *否则sidecar.st_ino为0，需要即时压缩，超过即时压缩缓存上限的文件只在chunked为true时压缩；
+     *vary表示该文件的响应随Accept-Encoding变化*/
+    static Compressor::Encoding Negotiate(const std::string &file, const struct stat &st,
+                                          const std::string &acceptEncoding, bool chunked, struct stat &sidecar,
+                                          bool &vary);
+    /*即时压缩的内容放不进缓存，以chunked流式发送*/
+    bool StreamEncoded() const;
+    /*解析Range头，返回-1表示格式错误或范围过多(忽略Range)，否则返回可满足的范围数，为0时应返回416*/
+    static int ParseRanges(const std::string &value, off_t size, std::vector<ByteRange> &ranges);
 
 public:
     HttpResponse();
     ~HttpResponse();
     void Init(const std::string &srcDIR, const std::string &path, bool isKeepAlive = false, int code = -1);
-    void UnmapFile(); //关闭目标文件映射到内存，释放内存
+    void UnmapFile(); //释放对文件内容的持有，没有其他持有者时解除映射
+    /*只对GET请求的文件生效，在Init之后、Respond之前调用*/
+    void SetRange(const std::string &range, const std::string &ifRange) {
+        m_range = range;
+        m_ifRange = ifRange;
+    }
+    void SetAcceptEncoding(const std::string &acceptEncoding) {
+        m_acceptEncoding = acceptEncoding;
+    }
+    void SetAcceptChunked(bool acceptChunked) {
+        m_acceptChunked = acceptChunked;
+    }
+    /*条件GET：与文件当前的ETag或修改时间一致时返回304，不打开文件*/
+    void SetConditions(const std::string &ifNoneMatch, const std::string &ifModifiedSince) {
+        m_ifNoneMatch = ifNoneMatch;
+        m_ifModifiedSince = ifModifiedSince;
+    }
     void Respond(Buffer &buff);
-    void WriteErrorContent(Buffer &buff, std::string message); //写错误HTML返回给客户端
-    char *File();
+    /*Respond追加到写缓冲区的内容和文件内容的发送顺序*/
+    const std::vector<BodyPart> &Parts() const {
+        return m_parts;
+    }
+    /*chunked响应的消息体，排在Parts之后发送；不是chunked响应时为nullptr*/
+    std::shared_ptr<ChunkedBody> Chunked() const {
+        return m_chunked;
+    }
+    void WriteErrorContent(Buffer &buff, std::string message); //写错误HTML返回给客户端，Content-length之前补上Date
+    /*不读磁盘即可生成响应时返回true：目标文件(或不存在、无权限时对应的错误页)已在缓存中且不超过maxBytes，
+     *或者条件请求将得到304*/
+    static bool ServableFromCache(const std::string &srcDir, const std::string &path, size_t maxBytes,
+                                  const std::string &ifNoneMatch, const std::string &ifModifiedSince,
+                                  const std::string &acceptEncoding, bool acceptChunked);
+    const char *File() const;
+    /*文件内容的共享持有者，排队发送的响应通过它保证发送完之前内容有效*/
+    std::shared_ptr<const char> FileHolder() const;
     size_t FileLen() const;
     int Code() const {
         return m_code;
     }
+    /*按文件后缀(如".css")配置的Cache-Control，"*"为其他后缀的默认值；只在启动时修改*/
+    static std::unordered_map<std::string, std::string> cacheControl;
 };
 
 #endif // !RESPOND_HTTP_H
@@ -0,0 +1,240 @@
+#include "warmup.h"
+#include "../log/log.h"
+#include "../utils/clock.h"
+#include "file_cache.h"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+
+namespace {
+
+struct WarmFile {
+    std::string path; //相对资源目录，以'/'开头
+    off_t size;
+};
+
+/*递归收集资源目录下其他用户可读的普通文件*/
+void Collect(const std::string &root, const std::string &rel, std::vector<WarmFile> &files) {
+    DIR *dir = opendir((root + rel).c_str());
+    if (!dir) {
+        return;
+    }
+    while (struct dirent *ent = readdir(dir)) {
+        std::string name = ent->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        std::string path = rel + "/" + name;
+        struct stat st;
+        if (stat((root + path).c_str(), &st) < 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            Collect(root, path, files);
+        } else if (S_ISREG(st.st_mode) && (st.st_mode & S_IROTH)) {
+            files.push_back({path, st.st_size});
+        }
+    }
+    closedir(dir);
+}
+
+} // namespace
+
+Warmup::Warmup() : m_dirty(false), m_intervalSec(0), m_isClosed(true) {
+    NameLock(m_mutex, "hit_list");
+}
+
+Warmup::~Warmup() {
+    Stop();
+}
+
+Warmup *Warmup::Instance() {
+    static Warmup warmup;
+    return &warmup;
+}
+
+void Warmup::RecordHit(const std::string &path) {
+    static thread_local uint32_t count = 0;
+    if (++count % HIT_SAMPLE == 0) {
+        Instance()->Record(path);
+    }
+}
+
+void Warmup::Record(const std::string &path) {
+    std::lock_guard<ServerMutex> locker(m_mutex);
+    auto it = m_hits.find(path);
+    if (it != m_hits.end()) {
+        it->second++;
+    } else if (m_hits.size() < MAX_PATHS) {
+        m_hits.emplace(path, 1);
+    }
+    m_dirty = true;
+}
+
+std::vector<std::string> Warmup::Load(const std::string &file) {
+    std::vector<std::pair<uint64_t, std::string>> items;
+    std::ifstream in(file);
+    uint64_t count;
+    std::string path;
+    while (in >> count && std::getline(in >> std::ws, path)) {
+        /*只接受资源目录内的路径*/
+        if (path.empty() || path[0] != '/' || path.find("/..") != std::string::npos) {
+            continue;
+        }
+        items.emplace_back(count, path);
+    }
+    std::stable_sort(items.begin(), items.end(),
+                     [](const std::pair<uint64_t, std::string> &a, const std::pair<uint64_t, std::string> &b) {
+                         return a.first > b.first;
+                     });
+    std::vector<std::string> paths;
+    std::lock_guard<ServerMutex> locker(m_mutex);
+    for (const auto &item : items) {
+        if (item.first / 2 > 0 && m_hits.size() < MAX_PATHS) {
+            m_hits[item.second] += item.first / 2; //旧的计数逐次减半，排名随访问模式变化
+        }
+        paths.push_back(item.second);
+    }
+    return paths;
+}
+
+void Warmup::Run(const std::string &root, const std::string &hitListFile, size_t budgetBytes, size_t lockBytes) {
+    int64_t start = NowNs();
+    std::vector<std::string> ranked;
+    if (!hitListFile.empty()) {
+        ranked = Load(hitListFile);
+    }
+    /*其余文件中小文件在前：同样的预算能覆盖更多文件，大文件发送时另有readahead*/
+    std::vector<WarmFile> rest;
+    Collect(root, "", rest);
+    std::stable_sort(rest.begin(), rest.end(), [](const WarmFile &a, const WarmFile &b) { return a.size < b.size; });
+    std::unordered_set<std::string> seen(ranked.begin(), ranked.end());
+    std::vector<std::string> order = ranked;
+    for (const WarmFile &f : rest) {
+        if (seen.insert(f.path).second) {
+            order.push_back(f.path);
+        }
+    }
+
+    size_t warmed = 0, warmedBytes = 0, cached = 0, locked = 0, lockedBytes = 0;
+    for (size_t i = 0; i < order.size() && warmedBytes < budgetBytes; i++) {
+        std::string file = root + order[i];
+        int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            continue; //命中列表中的文件可能已被删除
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || !(st.st_mode & S_IROTH) ||
+            static_cast<size_t>(st.st_size) > budgetBytes - warmedBytes) {
+            close(fd);
+            continue;
+        }
+        size_t len = st.st_size;
+        posix_fadvise(fd, 0, len, POSIX_FADV_WILLNEED); //异步预读，不阻塞启动
+        warmed++;
+        warmedBytes += len;
+        bool hot = i < ranked.size();
+        if (hot && lockedBytes + len <= lockBytes && len > 0) {
+            void *addr = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+            if (addr != MAP_FAILED && mlock(addr, len) == 0) {
+                m_locked.emplace_back(addr, [len](void *p) { munmap(p, len); });
+                locked++;
+                lockedBytes += len;
+            } else {
+                if (addr != MAP_FAILED) {
+                    munmap(addr, len);
+                }
+                LOG_WARN("Warmup mlock %s error:%s, check RLIMIT_MEMLOCK", file.c_str(), strerror(errno));
+                lockBytes = 0; //多半是超过了RLIMIT_MEMLOCK，不再尝试
+            }
+        }
+        close(fd);
+        /*上次的热点小文件直接读入缓存，第一批请求就能在事件循环中处理*/
+        if (hot && FileCache::Instance()->Get(file, st, true)) {
+            cached++;
+        }
+    }
+    LOG_INFO("Warmup: %zu of %zu files, %zuKB prefetched, %zu cached, %zu locked (%zuKB), %zu from hit list, "
+             "%.1fms",
+             warmed, order.size(), warmedBytes >> 10, cached, locked, lockedBytes >> 10, ranked.size(),
+             (NowNs() - start) / 1e6);
+}
+
+bool Warmup::Save() {
+    std::vector<std::pair<uint64_t, std::string>> items;
+    {
+        std::lock_guard<ServerMutex> locker(m_mutex);
+        if (!m_dirty) {
+            return true;
+        }
+        m_dirty = false;
+        for (const auto &item : m_hits) {
+            items.emplace_back(item.second, item.first);
+        }
+    }
+    std::sort(items.begin(), items.end(),
+              [](const std::pair<uint64_t, std::string> &a, const std::pair<uint64_t, std::string> &b) {
+                  return a.first > b.first;
+              });
+    /*先写临时文件再rename，进程在写入中途退出也不会留下不完整的列表*/
+    std::string tmp = m_file + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        for (const auto &item : items) {
+            out << item.first << ' ' << item.second << '\n';
+        }
+        if (!out) {
+            LOG_WARN("Hit list write %s error!", tmp.c_str());
+            return false;
+        }
+    }
+    if (rename(tmp.c_str(), m_file.c_str()) < 0) {
+        LOG_WARN("Hit list rename %s error:%s", m_file.c_str(), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void Warmup::StartSaver(const std::string &hitListFile, int intervalSec) {
+    assert(m_isClosed && intervalSec > 0);
+    m_file = hitListFile;
+    m_intervalSec = intervalSec;
+    m_isClosed = false;
+    m_thread = std::thread(&Warmup::SaverLoop, this);
+}
+
+void Warmup::Stop() {
+    {
+        std::lock_guard<std::mutex> locker(m_saverMutex);
+        if (m_isClosed) {
+            return;
+        }
+        m_isClosed = true;
+    }
+    m_cond.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    Save();
+}
+
+void Warmup::SaverLoop() {
+    std::unique_lock<std::mutex> locker(m_saverMutex);
+    while (!m_isClosed) {
+        m_cond.wait_for(locker, std::chrono::seconds(m_intervalSec));
+        if (m_isClosed) {
+            break;
+        }
+        locker.unlock();
+        Save();
+        locker.lock();
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef WARMUP_H
+#define WARMUP_H
+
+#include "../metrics/lock_stats.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*启动预热与命中列表
+ *运行期间对成功响应的文件路径抽样计数，后台线程定期写入命中列表文件(按次数降序，每行"次数 路径")；
+ *下次启动时按命中列表排序，再加上资源目录中其余的文件(小文件在前)，在字节预算内依次
+ *posix_fadvise(WILLNEED)让内核预读进页缓存，命中列表中的小文件同时读入FileCache，
+ *可选地把最热的文件映射并mlock，常驻内存*/
+class Warmup
+{
+public:
+    static Warmup *Instance();
+    /*root为资源目录，hitListFile为空时只遍历目录；budgetBytes为预读的总字节数上限，lockBytes为mlock的字节数上限*/
+    void Run(const std::string &root, const std::string &hitListFile, size_t budgetBytes, size_t lockBytes);
+    /*在工作线程或事件循环中调用，每HIT_SAMPLE次记录一次*/
+    static void RecordHit(const std::string &path);
+    /*每intervalSec秒保存一次命中列表，Stop时再保存一次*/
+    void StartSaver(const std::string &hitListFile, int intervalSec);
+    void Stop();
+
+private:
+    static const uint32_t HIT_SAMPLE = 16;
+    static const size_t MAX_PATHS = 65536; //计数的路径数上限，超过后不再加入新路径
+    ServerMutex m_mutex;
+    std::unordered_map<std::string, uint64_t> m_hits;
+    bool m_dirty;
+    std::vector<std::shared_ptr<void>> m_locked; //mlock的映射，进程退出前一直保持
+    std::string m_file;
+    int m_intervalSec;
+    std::thread m_thread;
+    std::mutex m_saverMutex;
+    std::condition_variable m_cond;
+    bool m_isClosed;
+
+    Warmup();
+    ~Warmup();
+    void Record(const std::string &path);
+    /*读入上次的命中列表，次数减半后作为本次计数的初值，返回按次数降序的路径*/
+    std::vector<std::string> Load(const std::string &file);
+    bool Save();
+    void SaverLoop();
+};
+
+#endif // !WARMUP_H
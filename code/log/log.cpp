@@ -1,4 +1,5 @@
 #include "log.h"
+#include <pthread.h>
 
 Log::Log() {
     m_lineCount = 0;
@@ -7,15 +8,30 @@ Log::Log() {
     m_reqQueue = nullptr;
     m_toDay = 0;
     m_fp = nullptr;
+    NameLock(m_mutex, "log");
 }
 
 Log::~Log() {
+    /*写线程仍可汇合时必须先join，否则std::thread析构会调用terminate*/
+    if (m_writeThread && m_writeThread->joinable()) {
+        while (!m_reqQueue->Empty()) {
+            m_reqQueue->Flush();
+        }
+        m_reqQueue->Close();
+        m_writeThread->join();
+    }
+    if (m_fp) {
+        std::lock_guard<ServerMutex> locker(m_mutex);
+        fflush(m_fp);
+        fclose(m_fp);
+        m_fp = nullptr;
+    }
 }
 
 void Log::AsyncWrite() {
     std::string str = "";
     while (m_reqQueue->Pop(str)) {
-        std::lock_guard<std::mutex> locker(m_mutex);
+        std::lock_guard<ServerMutex> locker(m_mutex);
         fputs(str.c_str(), m_fp);
     }
 }
@@ -46,6 +62,7 @@ Log *Log::Instance() {
 }
 
 void Log::ThreadWriteLog() {
+    pthread_setname_np(pthread_self(), "log"); //线程名用于性能分析时区分线程
     Log::Instance()->AsyncWrite();
 }
 
@@ -85,7 +102,7 @@ void Log::Init(int level, const char *path, const char *suffix, int maxRequests)
              sysTime.tm_mday, m_suffix);
     m_toDay = sysTime.tm_mday;
 
-    std::lock_guard<std::mutex> locker(m_mutex);
+    std::lock_guard<ServerMutex> locker(m_mutex);
     m_buff.RetrieveAll();
     if (m_fp) {
         Flush();
@@ -109,7 +126,7 @@ void Log::Write(int level, const char *format, ...) {
     struct tm sysTime = *localTime;
     va_list vaList; //可变参数
     if (m_toDay != sysTime.tm_mday || (m_lineCount && (m_lineCount % MAX_LINES == 0))) {
-        std::unique_lock<std::mutex> locker(m_mutex);
+        std::unique_lock<ServerMutex> locker(m_mutex);
         locker.unlock();
         char newFile[LOG_NAME_LEN];
         char tail[36] = {0};
@@ -128,7 +145,7 @@ void Log::Write(int level, const char *format, ...) {
         assert(m_fp != nullptr);
     }
 
-    std::unique_lock<std::mutex> locker(m_mutex);
+    std::unique_lock<ServerMutex> locker(m_mutex);
     m_lineCount++;
     int n = snprintf(m_buff.BeginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ", sysTime.tm_year + 1900,
                      sysTime.tm_mon + 1, sysTime.tm_mday, sysTime.tm_hour, sysTime.tm_min, sysTime.tm_sec, now.tv_usec);
@@ -149,11 +166,11 @@ void Log::Write(int level, const char *format, ...) {
 }
 
 int Log::GetLevel() {
-    std::lock_guard<std::mutex> locker(m_mutex);
+    std::lock_guard<ServerMutex> locker(m_mutex);
     return m_level;
 }
 
 void Log::SetLevel(int level) {
-    std::lock_guard<std::mutex> locker(m_mutex);
+    std::lock_guard<ServerMutex> locker(m_mutex);
     m_level = level;
 }
\ No newline at end of file
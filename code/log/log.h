@@ -34,7 +34,7 @@ private:
     FILE *m_fp;                                        //日志文件指针
     std::unique_ptr<LogQueue<std::string>> m_reqQueue; //请求队列
     std::unique_ptr<std::thread> m_writeThread;        //写线程
-    std::mutex m_mutex;                                //同步日志所需的互斥量
+    ServerMutex m_mutex;                               //同步日志所需的互斥量
 
 public:
     /*共有静态方法实例化，单例模式懒汉启动*/
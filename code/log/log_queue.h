@@ -1,5 +1,6 @@
 #ifndef LOG_QUEUE_H
 #define LOG_QUEUE_H
+#include "../metrics/lock_stats.h"
 #include <cassert>
 #include <condition_variable>
 #include <list>
@@ -40,16 +41,17 @@ public:
 private:
     std::list<T> m_workqueue; //底层数据结构双向链表
     size_t m_max_requests;    //队列最大任务数
-    std::mutex m_mutex;       //互斥量
+    ServerMutex m_mutex;      //互斥量
     bool isClosed;
-    std::condition_variable m_condConsumer; //条件变量，消费者
-    std::condition_variable m_condProducer; //生产者
+    ServerCondVar m_condConsumer; //条件变量，消费者
+    ServerCondVar m_condProducer; //生产者
 };
 
 template <typename T>
 LogQueue<T>::LogQueue(size_t MaxRequests) : m_max_requests(MaxRequests) {
     assert(MaxRequests > 0);
     isClosed = false;
+    NameLock(m_mutex, "log_queue");
 }
 
 template <class T>
@@ -59,19 +61,19 @@ LogQueue<T>::~LogQueue() {
 
 template <typename T>
 void LogQueue<T>::Clear() {
-    std::lock_guard<std::mutex> locker(m_mutex);
+    std::lock_guard<ServerMutex> locker(m_mutex);
     m_workqueue.clear();
 }
 
 template <typename T>
 bool LogQueue<T>::Empty() {
-    std::lock_guard<std::mutex> locker(m_mutex);
+    std::lock_guard<ServerMutex> locker(m_mutex);
     return m_workqueue.empty();
 }
 
 template <typename T>
 bool LogQueue<T>::Full() {
-    std::lock_guard<std::mutex> locker(m_mutex);
+    std::lock_guard<ServerMutex> locker(m_mutex);
     return m_workqueue.size() >= m_max_requests;
 }
 
@@ -85,32 +87,32 @@ void LogQueue<T>::Close() {
 
 template <class T>
 size_t LogQueue<T>::Size() {
-    std::lock_guard<std::mutex> locker(m_mutex);
+    std::lock_guard<ServerMutex> locker(m_mutex);
     return m_workqueue.size();
 }
 
 template <class T>
 size_t LogQueue<T>::Capacity() {
-    std::lock_guard<std::mutex> locker(m_mutex);
+    std::lock_guard<ServerMutex> locker(m_mutex);
     return m_max_requests;
 }
 
 template <class T>
 T LogQueue<T>::Front() {
-    std::lock_guard<std::mutex> locker(m_mutex);
+    std::lock_guard<ServerMutex> locker(m_mutex);
     return m_workqueue.front();
 }
 
 template <class T>
 T LogQueue<T>::Back() {
-    std::lock_guard<std::mutex> locker(m_mutex);
+    std::lock_guard<ServerMutex> locker(m_mutex);
     return m_workqueue.back();
 }
 
 template <class T>
 void LogQueue<T>::PushBack(const T &task) {
     /*条件变量需要搭配unique_lock*/
-    std::unique_lock<std::mutex> locker(m_mutex);
+    std::unique_lock<ServerMutex> locker(m_mutex);
     while (m_workqueue.size() >= m_max_requests) { //队列已满需要等待
         m_condProducer.wait(locker);               //阻塞当前线程，直到条件变量被唤醒
     }
@@ -121,7 +123,7 @@ void LogQueue<T>::PushBack(const T &task) {
 template <class T>
 void LogQueue<T>::PushFront(const T &task) {
     /*条件变量需要搭配unique_lock*/
-    std::unique_lock<std::mutex> locker(m_mutex);
+    std::unique_lock<ServerMutex> locker(m_mutex);
     while (m_workqueue.size() >= m_max_requests) { //队列已满需要等待
         m_condProducer.wait(locker);
     }
@@ -132,7 +134,7 @@ void LogQueue<T>::PushFront(const T &task) {
 template <class T>
 bool LogQueue<T>::Pop(T &task) {
     /*条件变量需要搭配unique_lock*/
-    std::unique_lock<std::mutex> locker(m_mutex);
+    std::unique_lock<ServerMutex> locker(m_mutex);
     while (m_workqueue.empty()) { //队列已空需要等待
         m_condConsumer.wait(locker);
         if (isClosed) {
@@ -148,7 +150,7 @@ bool LogQueue<T>::Pop(T &task) {
 template <class T>
 bool LogQueue<T>::Pop(T &task, int timeout) {
     /*条件变量需要搭配unique_lock*/
-    std::unique_lock<std::mutex> locker(m_mutex);
+    std::unique_lock<ServerMutex> locker(m_mutex);
     while (m_workqueue.empty()) {
         if (m_condConsumer.wait_for(locker, std::chrono::seconds(timeout)) == std::cv_status::timeout) {
             return false;
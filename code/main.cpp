@@ -1,17 +1,311 @@
 #include "server/server.h"
+#include <getopt.h>
+
+static void Usage(const char *name) {
+    printf("usage: %s <port> <threadNum> <connPoolNum> [options]\n", name);
+    printf("  --user-filter-capacity <n>  expected users in username bloom filter, 0 to disable\n");
+    printf("  --user-filter-fp-rate <p>   bloom filter false positive rate, 0 < p < 1\n");
+    printf("  --user-store <mysql|memory> user store backend, memory needs no mysqld\n");
+    printf("  --user-store-latency <us>   artificial latency per memory store access\n");
+    printf("  --admin-port <port>         serve /metrics on this port, 0 to disable\n");
+    printf("  --admin-addr <ip>           admin listen address (default 127.0.0.1)\n");
+    printf("  --trace-sample <n>          trace one of every n requests, 0 to disable\n");
+    printf("  --slow-request-ms <ms>      log requests slower than this, 0 to disable (default 1000)\n");
+    printf("  --loop-stall-ms <ms>        warn with a stack when the event loop blocks this long, 0 to disable (default 100)\n");
+    printf("  --lock-stats                record lock wait/hold times (build with make LOCK_STATS=1)\n");
+    printf("  --backlog <n>               listen backlog (default 1024, capped by somaxconn)\n");
+    printf("  --defer-accept <s>          TCP_DEFER_ACCEPT seconds, 0 to disable (default 1)\n");
+    printf("  --fastopen <n>              TCP_FASTOPEN queue length, 0 to disable (default 0)\n");
+    printf("  --nodelay <0|1>             TCP_NODELAY on accepted sockets (default 1)\n");
+    printf("  --cork <0|1>                TCP_CORK while writing large responses (default 1)\n");
+    printf("  --sndbuf <bytes>            SO_SNDBUF, 0 for kernel default\n");
+    printf("  --rcvbuf <bytes>            SO_RCVBUF, 0 for kernel default\n");
+    printf("  --accept-batch <n>          max connections accepted per loop iteration, > 0 (default 64)\n");
+    printf("  --overload-target-ms <ms>   shed with 503 when pool queue wait stays above this, 0 to disable (default 50)\n");
+    printf("  --overload-interval-ms <ms> window for the standing queue check, > 0 (default 100)\n");
+    printf("  --overload-max-queue <n>    shed when this many tasks are queued, 0 for no limit (default 10000)\n");
+    printf("  --retry-after <s>           Retry-After of the 503 response (default 1)\n");
+    printf("  --file-cache-mb <n>         small file cache size, 0 to disable (default 64)\n");
+    printf("  --file-cache-max-kb <n>     largest file kept in the cache (default 64)\n");
+    printf("  --inline-max-kb <n>         serve cached responses up to this size on the event loop, 0 to disable (default 16)\n");
+    printf("  --pack <file>               serve resources from an asset pack built by bin/pack\n");
+    printf("  --pack-populate             prefault the whole pack with MAP_POPULATE\n");
+    printf("  --pack-hugepages            copy the pack into transparent huge pages\n");
+    printf("  --warmup-mb <n>             prefetch up to n MB of resources at startup, 0 disables (default 256)\n");
+    printf("  --warmup-mlock-mb <n>       mlock up to n MB of the hottest files (default 0)\n");
+    printf("  --hit-list <file>           rank warmup by a hit list saved by the previous run\n");
+    printf("  --hit-list-sec <n>          save the hit list every n seconds (default 60)\n");
+    printf("  --max-body-mb <n>           reject request bodies larger than n MB with 413 (default 64)\n");
+    printf("  --body-tmp-dir <dir>        directory for request bodies over 64KB (default /tmp)\n");
+    printf("  --header-cache-kb <n>       cache of prebuilt response headers, 0 to build them per request (default 1024)\n");
+    printf("  --compress-cache-mb <n>     cache of gzip/br responses compressed on the fly, 0 to use only .gz/.br files (default 16)\n");
+    printf("  --compress-max-kb <n>       largest file compressed on the fly (default 1024)\n");
+    printf("  --cache-control <sfx>=<v>   Cache-Control for files with this suffix, e.g. .css=max-age=86400,\n");
+    printf("                              '*' for other suffixes; may be repeated\n");
+    printf("  --write-high-kb <n>         stop processing pipelined requests above this many queued bytes (default 256)\n");
+    printf("  --write-low-kb <n>          resume below this many queued bytes, <= high (default 64)\n");
+    printf("  --write-budget-kb <n>       max bytes written per connection per turn, > 0 (default 1024)\n");
+    printf("  --log-level <0-3>           debug, info, warn, error (default 1)\n");
+}
 
 int main(int argc, char *argv[]) {
-    if (argc != 4) {
-        printf("usage: %s <port> <threadNum> <connPoolNum>\n", argv[0]);
+    static const struct option longOptions[] = {
+        {"user-filter-capacity", required_argument, nullptr, 'c'},
+        {"user-filter-fp-rate", required_argument, nullptr, 'f'},
+        {"user-store", required_argument, nullptr, 's'},
+        {"user-store-latency", required_argument, nullptr, 'l'},
+        {"admin-port", required_argument, nullptr, 'a'},
+        {"admin-addr", required_argument, nullptr, 'A'},
+        {"trace-sample", required_argument, nullptr, 't'},
+        {"slow-request-ms", required_argument, nullptr, 'S'},
+        {"loop-stall-ms", required_argument, nullptr, 'W'},
+        {"lock-stats", no_argument, nullptr, 'K'},
+        {"backlog", required_argument, nullptr, 'b'},
+        {"defer-accept", required_argument, nullptr, 'd'},
+        {"fastopen", required_argument, nullptr, 'F'},
+        {"nodelay", required_argument, nullptr, 'N'},
+        {"cork", required_argument, nullptr, 'C'},
+        {"sndbuf", required_argument, nullptr, 'O'},
+        {"rcvbuf", required_argument, nullptr, 'I'},
+        {"accept-batch", required_argument, nullptr, 'B'},
+        {"overload-target-ms", required_argument, nullptr, 'o'},
+        {"overload-interval-ms", required_argument, nullptr, 'i'},
+        {"overload-max-queue", required_argument, nullptr, 'q'},
+        {"retry-after", required_argument, nullptr, 'r'},
+        {"file-cache-mb", required_argument, nullptr, 'm'},
+        {"file-cache-max-kb", required_argument, nullptr, 'M'},
+        {"inline-max-kb", required_argument, nullptr, 'n'},
+        {"pack", required_argument, nullptr, 'p'},
+        {"pack-populate", no_argument, nullptr, 'P'},
+        {"pack-hugepages", no_argument, nullptr, 'G'},
+        {"warmup-mb", required_argument, nullptr, 'x'},
+        {"warmup-mlock-mb", required_argument, nullptr, 'Y'},
+        {"hit-list", required_argument, nullptr, 'X'},
+        {"hit-list-sec", required_argument, nullptr, 'y'},
+        {"max-body-mb", required_argument, nullptr, 'j'},
+        {"body-tmp-dir", required_argument, nullptr, 'J'},
+        {"header-cache-kb", required_argument, nullptr, 'h'},
+        {"compress-cache-mb", required_argument, nullptr, 'z'},
+        {"compress-max-kb", required_argument, nullptr, 'Z'},
+        {"cache-control", required_argument, nullptr, 'E'},
+        {"write-high-kb", required_argument, nullptr, 'H'},
+        {"write-low-kb", required_argument, nullptr, 'w'},
+        {"write-budget-kb", required_argument, nullptr, 'U'},
+        {"log-level", required_argument, nullptr, 'L'},
+        {nullptr, 0, nullptr, 0},
+    };
+    ServerConfig config;
+    int logLevel = 1;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+        switch (opt) {
+            case 'c':
+                config.userFilterCapacity = strtoull(optarg, nullptr, 10);
+                break;
+            case 'f':
+                config.userFilterFpRate = atof(optarg);
+                if (!(config.userFilterFpRate > 0 && config.userFilterFpRate < 1)) {
+                    Usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 's':
+                config.userStore = optarg;
+                if (config.userStore != "mysql" && config.userStore != "memory") {
+                    Usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'l':
+                config.userStoreLatencyUs = atoi(optarg);
+                if (config.userStoreLatencyUs < 0) {
+                    Usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'a':
+                config.adminPort = atoi(optarg);
+                break;
+            case 'A':
+                config.adminAddr = optarg;
+                break;
+            case 't':
+                config.traceSampleEvery = strtoul(optarg, nullptr, 10);
+                break;
+            case 'S':
+                config.slowRequestMs = atoi(optarg);
+                if (config.slowRequestMs < 0) {
+                    Usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'W':
+                config.loopStallMs = atoi(optarg);
+                if (config.loopStallMs < 0) {
+                    Usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'K':
+                config.lockStats = true;
+                break;
+            case 'b':
+                config.socket.backlog = atoi(optarg);
+                if (config.socket.backlog <= 0) {
+                    Usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'd':
+                config.socket.deferAcceptSec = atoi(optarg);
+                break;
+            case 'F':
+                config.socket.fastOpenQueue = atoi(optarg);
+                break;
+            case 'N':
+                config.socket.noDelay = atoi(optarg) != 0;
+                break;
+            case 'C':
+                config.socket.cork = atoi(optarg) != 0;
+                break;
+            case 'O':
+                config.socket.sndBuf = atoi(optarg);
+                break;
+            case 'I':
+                config.socket.rcvBuf = atoi(optarg);
+                break;
+            case 'B':
+                config.acceptBatch = atoi(optarg);
+                if (config.acceptBatch <= 0) {
+                    Usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'o':
+                config.overloadTargetMs = atoi(optarg);
+                if (config.overloadTargetMs < 0) {
+                    Usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'i':
+                config.overloadIntervalMs = atoi(optarg);
+                if (config.overloadIntervalMs <= 0) {
+                    Usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'q':
+                config.overloadMaxQueue = strtoull(optarg, nullptr, 10);
+                break;
+            case 'r':
+                config.retryAfterSec = atoi(optarg);
+                break;
+            case 'm':
+                config.fileCacheBytes = strtoull(optarg, nullptr, 10) << 20;
+                break;
+            case 'M':
+                config.fileCacheMaxFile = strtoull(optarg, nullptr, 10) << 10;
+                break;
+            case 'n':
+                config.inlineMaxBytes = strtoull(optarg, nullptr, 10) << 10;
+                break;
+            case 'p':
+                config.packFile = optarg;
+                break;
+            case 'P':
+                config.packPopulate = true;
+                break;
+            case 'G':
+                config.packHugePages = true;
+                break;
+            case 'x':
+                config.warmupBytes = strtoull(optarg, nullptr, 10) << 20;
+                break;
+            case 'Y':
+                config.warmupLockBytes = strtoull(optarg, nullptr, 10) << 20;
+                break;
+            case 'X':
+                config.hitListFile = optarg;
+                break;
+            case 'j':
+                config.maxBodyBytes = strtoull(optarg, nullptr, 10) << 20;
+                break;
+            case 'J':
+                config.bodyTmpDir = optarg;
+                break;
+            case 'y':
+                config.hitListIntervalSec = atoi(optarg);
+                if (config.hitListIntervalSec <= 0) {
+                    Usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'h':
+                config.headerCacheBytes = strtoull(optarg, nullptr, 10) << 10;
+                break;
+            case 'z':
+                config.compressCacheBytes = strtoull(optarg, nullptr, 10) << 20;
+                break;
+            case 'Z':
+                config.compressMaxFile = strtoull(optarg, nullptr, 10) << 10;
+                break;
+            case 'E': {
+                const char *eq = strchr(optarg, '=');
+                if (eq == nullptr || eq == optarg) {
+                    Usage(argv[0]);
+                    exit(1);
+                }
+                config.cacheControl.emplace_back(std::string(optarg, eq - optarg), eq + 1);
+                break;
+            }
+            case 'H':
+                config.writeHighWater = strtoull(optarg, nullptr, 10) << 10;
+                break;
+            case 'w':
+                config.writeLowWater = strtoull(optarg, nullptr, 10) << 10;
+                break;
+            case 'U':
+                config.writeBudget = strtoull(optarg, nullptr, 10) << 10;
+                break;
+            case 'L':
+                logLevel = atoi(optarg);
+                if (logLevel < 0 || logLevel > 3) {
+                    Usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            default:
+                Usage(argv[0]);
+                exit(1);
+        }
+    }
+    /*高低水位可以按任意顺序给出，解析完再比较*/
+    if (config.writeBudget == 0 || config.writeLowWater > config.writeHighWater) {
+        Usage(argv[0]);
+        exit(1);
+    }
+    if (argc - optind != 3) {
+        Usage(argv[0]);
+        exit(1);
+    }
+    int port = atoi(argv[optind]);
+    if (port <= 1024) {
+        Usage(argv[0]);
+        exit(1);
+    }
+    int threadNum = atoi(argv[optind + 1]);
+    if (threadNum <= 0) {
+        Usage(argv[0]);
+        exit(1);
+    }
+    int connPoolNum = atoi(argv[optind + 2]);
+    if (connPoolNum <= 0) {
+        Usage(argv[0]);
         exit(1);
     }
-    int port = atoi(argv[1]);
-    assert(port > 1024);
-    int threadNum = atoi(argv[2]);
-    assert(threadNum > 0);
-    int connPoolNum = atoi(argv[3]);
-    assert(connPoolNum > 0);
-    Server server(port, 3, 60000, false, 3306, "root", "root", "server", connPoolNum, threadNum, true, 1, 1024);
+    Server server(port, 3, 60000, false, 3306, "root", "root", "server", connPoolNum, threadNum, true, logLevel, 1024,
+                  config);
     server.Start();
     return 0;
 }
@@ -0,0 +1,158 @@
+#include "lock_stats.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const double QUANTILES[] = {0.5, 0.99, 0.999};
+const int64_t HIGHEST_NS = 60LL * 1000 * 1000 * 1000;
+
+void UpdateMax(std::atomic<int64_t> &max, int64_t value) {
+    int64_t cur = max.load(std::memory_order_relaxed);
+    while (value > cur && !max.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+    }
+}
+
+void AppendSummary(std::string &out, const char *name, const std::string &lock, const HdrHistogram &h) {
+    char line[256];
+    for (double q : QUANTILES) {
+        snprintf(line, sizeof(line), "%s{lock=\"%s\",quantile=\"%g\"} %.9f\n", name, lock.c_str(), q,
+                 h.ValueAtPercentile(q * 100) / 1e9);
+        out += line;
+    }
+    snprintf(line, sizeof(line), "%s_sum{lock=\"%s\"} %.9f\n%s_count{lock=\"%s\"} %llu\n", name, lock.c_str(),
+             h.Sum() / 1e9, name, lock.c_str(), static_cast<unsigned long long>(h.TotalCount()));
+    out += line;
+}
+
+} // namespace
+
+std::atomic<bool> LockStats::s_enabled(false);
+
+/*持有时间常在100ns以内，最小精度取1ns*/
+LockStats::Stats::Stats() : contended(0), maxWaitNs(0), maxHoldNs(0), waitNs(1, HIGHEST_NS, 2), holdNs(1, HIGHEST_NS, 2) {}
+
+void LockStats::Stats::OnAcquire(int64_t wait, bool isContended) {
+    if (isContended) {
+        contended.fetch_add(1, std::memory_order_relaxed);
+        waitNs.Record(wait);
+        UpdateMax(maxWaitNs, wait);
+    }
+}
+
+void LockStats::Stats::OnRelease(int64_t hold) {
+    holdNs.Record(hold);
+    UpdateMax(maxHoldNs, hold);
+}
+
+void LockStats::Stats::Reset() {
+    contended.store(0, std::memory_order_relaxed);
+    maxWaitNs.store(0, std::memory_order_relaxed);
+    maxHoldNs.store(0, std::memory_order_relaxed);
+    waitNs.Reset();
+    holdNs.Reset();
+}
+
+LockStats *LockStats::Instance() {
+    /*有意不释放：日志等单例在退出析构时仍会加锁，统计必须比它们活得更久*/
+    static LockStats *stats = new LockStats();
+    return stats;
+}
+
+bool LockStats::CompiledIn() {
+#ifdef LOCK_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+LockStats::Stats *LockStats::Unnamed() {
+    static Stats *stats = new Stats();
+    return stats;
+}
+
+LockStats::Stats *LockStats::Get(const std::string &name) {
+    std::lock_guard<std::mutex> locker(m_mutex);
+    std::unique_ptr<Stats> &stats = m_stats[name];
+    if (!stats) {
+        stats.reset(new Stats());
+    }
+    return stats.get();
+}
+
+void LockStats::Reset() {
+    std::lock_guard<std::mutex> locker(m_mutex);
+    for (auto &kv : m_stats) {
+        kv.second->Reset();
+    }
+}
+
+std::string LockStats::Scrape() {
+    std::string out;
+    std::lock_guard<std::mutex> locker(m_mutex);
+    if (m_stats.empty()) {
+        return out;
+    }
+    char line[256];
+    out += "# HELP webserver_lock_contended_total Lock acquisitions that had to block.\n"
+           "# TYPE webserver_lock_contended_total counter\n";
+    for (const auto &kv : m_stats) {
+        snprintf(line, sizeof(line), "webserver_lock_contended_total{lock=\"%s\"} %llu\n", kv.first.c_str(),
+                 static_cast<unsigned long long>(kv.second->contended.load(std::memory_order_relaxed)));
+        out += line;
+    }
+    out += "# HELP webserver_lock_wait_seconds Time spent blocked acquiring a contended lock.\n"
+           "# TYPE webserver_lock_wait_seconds summary\n";
+    for (const auto &kv : m_stats) {
+        AppendSummary(out, "webserver_lock_wait_seconds", kv.first, kv.second->waitNs);
+    }
+    out += "# HELP webserver_lock_hold_seconds Time a lock is held; count is the number of acquisitions.\n"
+           "# TYPE webserver_lock_hold_seconds summary\n";
+    for (const auto &kv : m_stats) {
+        AppendSummary(out, "webserver_lock_hold_seconds", kv.first, kv.second->holdNs);
+    }
+    return out;
+}
+
+std::string LockStats::Report() {
+    std::string out;
+    char line[256];
+    snprintf(line, sizeof(line), "compiled in: %s, enabled: %s\n", CompiledIn() ? "yes" : "no (make LOCK_STATS=1)",
+             Enabled() ? "yes" : "no");
+    out += line;
+    std::vector<std::pair<std::string, Stats *>> rows;
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        for (const auto &kv : m_stats) {
+            rows.emplace_back(kv.first, kv.second.get());
+        }
+    }
+    std::sort(rows.begin(), rows.end(), [](const std::pair<std::string, Stats *> &a,
+                                           const std::pair<std::string, Stats *> &b) {
+        return a.second->waitNs.Sum() > b.second->waitNs.Sum();
+    });
+    snprintf(line, sizeof(line), "%-16s %12s %12s %8s %12s %10s %10s %12s %10s %10s\n", "lock", "acquires",
+             "contended", "cont%", "wait_ms", "wait_p99", "wait_max", "hold_ms", "hold_p99", "hold_max");
+    out += line;
+    for (const auto &row : rows) {
+        const Stats &s = *row.second;
+        uint64_t acquires = s.holdNs.TotalCount();
+        uint64_t contended = s.contended.load(std::memory_order_relaxed);
+        int64_t maxWait = s.maxWaitNs.load(std::memory_order_relaxed);
+        int64_t maxHold = s.maxHoldNs.load(std::memory_order_relaxed);
+        /*直方图按桶的上界给出分位数，不超过实测最大值*/
+        int64_t waitP99 = std::min(s.waitNs.ValueAtPercentile(99), maxWait);
+        int64_t holdP99 = std::min(s.holdNs.ValueAtPercentile(99), maxHold);
+        /*p99和max的单位为微秒*/
+        snprintf(line, sizeof(line), "%-16s %12llu %12llu %7.2f%% %12.3f %10.1f %10.1f %12.3f %10.1f %10.1f\n",
+                 row.first.c_str(), static_cast<unsigned long long>(acquires),
+                 static_cast<unsigned long long>(contended), acquires ? 100.0 * contended / acquires : 0.0,
+                 s.waitNs.Sum() / 1e6, waitP99 / 1e3, maxWait / 1e3, s.holdNs.Sum() / 1e6, holdP99 / 1e3,
+                 maxHold / 1e3);
+        out += line;
+    }
+    out += "(p99 and max in microseconds)\n";
+    return out;
+}
@@ -0,0 +1,129 @@
+#ifndef LOCK_STATS_H
+#define LOCK_STATS_H
+
+#include "../utils/clock.h"
+#include "../utils/hdr_histogram.h"
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/*按名字汇总的锁统计：获取次数、发生竞争的次数、等待时间和持有时间
+ *同名的多个锁实例共用一份统计*/
+class LockStats
+{
+public:
+    struct Stats {
+        std::atomic<uint64_t> contended; //try_lock失败、需要阻塞等待的次数
+        std::atomic<int64_t> maxWaitNs;
+        std::atomic<int64_t> maxHoldNs;
+        HdrHistogram waitNs; //只记录发生竞争的获取
+        HdrHistogram holdNs; //每次持有，总数即获取次数
+        Stats();
+        void OnAcquire(int64_t waitNs, bool contended);
+        void OnRelease(int64_t holdNs);
+        void Reset();
+    };
+
+    static LockStats *Instance();
+    /*运行时开关，关闭时加锁只多一次原子读和分支*/
+    static bool Enabled() {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+    static void SetEnabled(bool enabled) {
+        s_enabled.store(enabled, std::memory_order_relaxed);
+    }
+    /*是否编译了带统计的锁(make LOCK_STATS=1)*/
+    static bool CompiledIn();
+    /*取得名字对应的统计，不存在时创建，返回的指针在进程生命期内有效*/
+    Stats *Get(const std::string &name);
+    /*未命名的锁共用的统计，不出现在报告中*/
+    static Stats *Unnamed();
+    void Reset();
+    /*Prometheus文本格式，追加在/metrics之后*/
+    std::string Scrape();
+    /*按总等待时间排序的可读表格*/
+    std::string Report();
+
+private:
+    static std::atomic<bool> s_enabled;
+    std::mutex m_mutex; //本身不做统计
+    std::map<std::string, std::unique_ptr<Stats>> m_stats;
+
+    LockStats() = default;
+    ~LockStats() = default;
+};
+
+/*带统计的互斥量，满足Lockable要求，可配合lock_guard、unique_lock和condition_variable_any使用
+ *先try_lock，失败才计为竞争并计时等待；持有时间从获得锁到释放锁*/
+class InstrumentedMutex
+{
+public:
+    InstrumentedMutex() : m_stats(LockStats::Unnamed()), m_acquiredNs(0) {}
+    InstrumentedMutex(const InstrumentedMutex &) = delete;
+    InstrumentedMutex &operator=(const InstrumentedMutex &) = delete;
+
+    /*必须在锁第一次使用之前调用*/
+    void SetName(const char *name) {
+        m_stats = LockStats::Instance()->Get(name);
+    }
+    void lock() {
+        if (!LockStats::Enabled()) {
+            m_mutex.lock();
+            m_acquiredNs = 0;
+            return;
+        }
+        if (m_mutex.try_lock()) {
+            m_acquiredNs = NowNs();
+            m_stats->OnAcquire(0, false);
+            return;
+        }
+        int64_t start = NowNs();
+        m_mutex.lock();
+        m_acquiredNs = NowNs();
+        m_stats->OnAcquire(m_acquiredNs - start, true);
+    }
+    bool try_lock() {
+        if (!m_mutex.try_lock()) {
+            return false;
+        }
+        m_acquiredNs = 0;
+        if (LockStats::Enabled()) {
+            m_acquiredNs = NowNs();
+            m_stats->OnAcquire(0, false);
+        }
+        return true;
+    }
+    void unlock() {
+        /*m_acquiredNs只在持有锁时读写*/
+        if (m_acquiredNs) {
+            m_stats->OnRelease(NowNs() - m_acquiredNs);
+        }
+        m_mutex.unlock();
+    }
+
+private:
+    std::mutex m_mutex;
+    LockStats::Stats *m_stats;
+    int64_t m_acquiredNs; //为0表示本次获取没有计时
+};
+
+/*服务器中热点路径上的锁统一使用ServerMutex和ServerCondVar
+ *默认即std::mutex和std::condition_variable，没有额外开销；以make LOCK_STATS=1编译时换成带统计的锁*/
+#ifdef LOCK_STATS
+typedef InstrumentedMutex ServerMutex;
+typedef std::condition_variable_any ServerCondVar;
+#else
+typedef std::mutex ServerMutex;
+typedef std::condition_variable ServerCondVar;
+#endif
+
+/*为锁指定统计使用的名字，未编译统计时为空操作*/
+inline void NameLock(std::mutex &, const char *) {}
+inline void NameLock(InstrumentedMutex &mutex, const char *name) {
+    mutex.SetName(name);
+}
+
+#endif // !LOCK_STATS_H
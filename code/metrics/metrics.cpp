@@ -0,0 +1,145 @@
+#include "metrics.h"
+#include <cstdio>
+
+namespace {
+
+struct MetricDesc {
+    const char *name;
+    const char *help;
+};
+
+const MetricDesc COUNTER_DESC[Metrics::COUNTER_NUM] = {
+    {"webserver_accepts_total", "Accepted client connections."},
+    {"webserver_bytes_out_total", "Response bytes written to sockets."},
+    {"webserver_timer_expirations_total", "Idle connections closed by the heap timer."},
+    {"webserver_slow_requests_total", "Requests slower than the slow request threshold."},
+    {"webserver_loop_stalls_total", "Event loop iterations longer than the stall threshold."},
+    {"webserver_shed_total", "Requests answered with 503 by the event loop due to overload."},
+    {"webserver_inline_requests_total", "Requests served directly on the event loop thread from the file cache."},
+    {"webserver_file_cache_hits_total", "Small file cache hits."},
+    {"webserver_file_cache_misses_total", "Small files read from disk into the cache."},
+    {"webserver_completions_total", "Worker completions applied by the event loop."},
+    {"webserver_loop_wakeups_total", "Event loop wakeups through the completion eventfd."},
+    {"webserver_write_high_water_total", "Times pipelined request processing paused at the outgoing high watermark."},
+    {"webserver_write_yields_total", "Writes that stopped at the per-turn write budget with data left."},
+    {"webserver_read_pauses_total", "Reads that stopped because the read buffer reached the high watermark."},
+    {"webserver_compressions_total", "Responses compressed on the fly because the encoded cache missed."},
+};
+
+const MetricDesc HISTOGRAM_DESC[Metrics::HISTOGRAM_NUM] = {
+    {"webserver_queue_wait_seconds", "Time tasks wait in the ThreadPool queue."},
+    {"webserver_parse_seconds", "Time spent parsing a request."},
+    {"webserver_respond_seconds", "Time spent building a response (stat, open, mmap)."},
+    {"webserver_write_seconds", "Time spent writing responses to sockets."},
+    {"webserver_sql_wait_seconds", "Time spent waiting for a SqlConnPool connection."},
+    {"webserver_loop_busy_seconds", "Time the event loop spends handling one batch of epoll events."},
+    {"webserver_loop_interval_seconds", "Interval between consecutive epoll_wait returns."},
+};
+
+const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+/*直方图参数：1us~60s，2位有效数字*/
+HdrHistogram *NewHistogram() {
+    return new HdrHistogram(1000, 60LL * 1000 * 1000 * 1000, 2);
+}
+
+void AppendHeader(std::string &out, const char *name, const char *help, const char *type) {
+    out += "# HELP ";
+    out += name;
+    out += " ";
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += " ";
+    out += type;
+    out += "\n";
+}
+
+} // namespace
+
+thread_local Metrics::Shard *Metrics::t_shard = nullptr;
+
+Metrics::Shard::Shard() {
+    for (int i = 0; i < COUNTER_NUM; i++) {
+        counters[i].store(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < MAX_STATUS; i++) {
+        status[i].store(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < HISTOGRAM_NUM; i++) {
+        histograms[i].reset(NewHistogram());
+    }
+}
+
+Metrics *Metrics::Instance() {
+    static Metrics metrics;
+    return &metrics;
+}
+
+Metrics::Shard *Metrics::Register() {
+    std::unique_ptr<Shard> shard(new Shard());
+    Shard *ptr = shard.get();
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_shards.push_back(std::move(shard));
+    return ptr;
+}
+
+void Metrics::AddGauge(const std::string &name, const std::string &help, std::function<double()> fn) {
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_gauges.push_back({name, help, std::move(fn)});
+}
+
+std::string Metrics::Scrape() {
+    std::string out;
+    char line[256];
+    uint64_t counters[COUNTER_NUM] = {0};
+    std::vector<uint64_t> status(MAX_STATUS, 0);
+    std::unique_ptr<HdrHistogram> histograms[HISTOGRAM_NUM];
+    for (int i = 0; i < HISTOGRAM_NUM; i++) {
+        histograms[i].reset(NewHistogram());
+    }
+    std::lock_guard<std::mutex> locker(m_mutex);
+    for (const auto &shard : m_shards) {
+        for (int i = 0; i < COUNTER_NUM; i++) {
+            counters[i] += shard->counters[i].load(std::memory_order_relaxed);
+        }
+        for (int i = 0; i < MAX_STATUS; i++) {
+            status[i] += shard->status[i].load(std::memory_order_relaxed);
+        }
+        for (int i = 0; i < HISTOGRAM_NUM; i++) {
+            histograms[i]->Merge(*shard->histograms[i]);
+        }
+    }
+
+    for (int i = 0; i < COUNTER_NUM; i++) {
+        AppendHeader(out, COUNTER_DESC[i].name, COUNTER_DESC[i].help, "counter");
+        snprintf(line, sizeof(line), "%s %llu\n", COUNTER_DESC[i].name, static_cast<unsigned long long>(counters[i]));
+        out += line;
+    }
+    AppendHeader(out, "webserver_responses_total", "Responses by HTTP status code.", "counter");
+    for (int i = 0; i < MAX_STATUS; i++) {
+        if (status[i]) {
+            snprintf(line, sizeof(line), "webserver_responses_total{code=\"%d\"} %llu\n", i,
+                     static_cast<unsigned long long>(status[i]));
+            out += line;
+        }
+    }
+    for (const Gauge &g : m_gauges) {
+        AppendHeader(out, g.name.c_str(), g.help.c_str(), "gauge");
+        snprintf(line, sizeof(line), "%s %.17g\n", g.name.c_str(), g.fn());
+        out += line;
+    }
+    for (int i = 0; i < HISTOGRAM_NUM; i++) {
+        const char *name = HISTOGRAM_DESC[i].name;
+        const HdrHistogram &h = *histograms[i];
+        AppendHeader(out, name, HISTOGRAM_DESC[i].help, "summary");
+        for (double q : QUANTILES) {
+            snprintf(line, sizeof(line), "%s{quantile=\"%g\"} %.9f\n", name, q, h.ValueAtPercentile(q * 100) / 1e9);
+            out += line;
+        }
+        snprintf(line, sizeof(line), "%s_sum %.9f\n%s_count %llu\n", name, h.Sum() / 1e9, name,
+                 static_cast<unsigned long long>(h.TotalCount()));
+        out += line;
+    }
+    return out;
+}
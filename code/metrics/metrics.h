@@ -0,0 +1,99 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "../utils/clock.h"
+#include "../utils/hdr_histogram.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*服务器运行指标
+ *每个线程第一次记录时注册一个私有分片，之后只写自己的分片(原子加法，无锁且不等待)，
+ *抓取时在admin线程中汇总所有分片，以Prometheus文本格式输出*/
+class Metrics
+{
+public:
+    /*计数器*/
+    enum CounterId {
+        ACCEPTS = 0,   //接受的连接数
+        BYTES_OUT,     //发送的字节数
+        TIMER_EXPIRED, //超时被关闭的连接数
+        SLOW_REQUESTS, //超过慢请求阈值的请求数
+        LOOP_STALLS,   //事件循环卡顿次数
+        SHED_REQUESTS, //过载或连接数超限时直接回复503的次数
+        INLINE_REQUESTS,   //在事件循环中直接处理的请求数
+        FILE_CACHE_HITS,   //小文件缓存命中次数
+        FILE_CACHE_MISSES, //小文件缓存未命中、从磁盘读入的次数
+        COMPLETIONS,       //事件循环处理的完成通知数
+        LOOP_WAKEUPS,      //工作线程通过eventfd唤醒事件循环的次数
+        WRITE_HIGH_WATER,  //待发送字节数达到高水位，暂停处理流水线请求的次数
+        WRITE_YIELDS,      //用完写预算、让出线程的次数
+        READ_PAUSES,       //读缓冲区达到高水位、暂停读的次数
+        COMPRESSIONS,      //即时压缩的次数(压缩结果缓存未命中)
+        COUNTER_NUM
+    };
+    /*耗时直方图，单位纳秒*/
+    enum HistogramId {
+        QUEUE_WAIT = 0, //任务在线程池队列中的等待时间
+        PARSE,          //解析请求
+        RESPOND,        //生成响应(stat、open、mmap)
+        WRITE,          //向socket写响应
+        SQL_WAIT,       //等待数据库连接
+        LOOP_BUSY,      //事件循环处理一轮事件的耗时
+        LOOP_INTERVAL,  //事件循环两次从epoll_wait返回的间隔
+        HISTOGRAM_NUM
+    };
+    static const int MAX_STATUS = 600;
+
+    static Metrics *Instance();
+    static void Add(CounterId id, uint64_t n = 1) {
+        Local()->counters[id].fetch_add(n, std::memory_order_relaxed);
+    }
+    static void Record(HistogramId id, int64_t ns) {
+        Local()->histograms[id]->Record(ns);
+    }
+    /*按响应状态码计数*/
+    static void CountStatus(int code) {
+        if (code < 0 || code >= MAX_STATUS) {
+            code = 0;
+        }
+        Local()->status[code].fetch_add(1, std::memory_order_relaxed);
+    }
+    /*注册一个抓取时才计算的瞬时值，如活跃连接数、队列长度*/
+    void AddGauge(const std::string &name, const std::string &help, std::function<double()> fn);
+    /*汇总所有分片，返回Prometheus文本格式*/
+    std::string Scrape();
+
+private:
+    struct Shard {
+        std::atomic<uint64_t> counters[COUNTER_NUM];
+        std::atomic<uint64_t> status[MAX_STATUS];
+        std::unique_ptr<HdrHistogram> histograms[HISTOGRAM_NUM];
+        Shard();
+    };
+    struct Gauge {
+        std::string name;
+        std::string help;
+        std::function<double()> fn;
+    };
+
+    static thread_local Shard *t_shard; //本线程的分片
+    std::mutex m_mutex;                 //只保护分片注册和抓取，不在请求路径上
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::vector<Gauge> m_gauges;
+
+    Metrics() = default;
+    ~Metrics() = default;
+    static Shard *Local() {
+        if (!t_shard) {
+            t_shard = Instance()->Register();
+        }
+        return t_shard;
+    }
+    Shard *Register();
+};
+
+#endif // !METRICS_H
@@ -0,0 +1,193 @@
+#include "profiler.h"
+#include "../log/log.h"
+#include <cerrno>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <map>
+#include <memory>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+/*信号处理函数和信号返回跳板占据栈顶的两帧*/
+const int SKIP_FRAMES = 2;
+
+std::string ThreadName(int tid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/comm", tid);
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return "thread-" + std::to_string(tid);
+    }
+    char name[32] = {0};
+    if (!fgets(name, sizeof(name), fp)) {
+        name[0] = '\0';
+    }
+    fclose(fp);
+    std::string res(name);
+    while (!res.empty() && (res.back() == '\n' || res.back() == ' ')) {
+        res.pop_back();
+    }
+    return res.empty() ? "thread-" + std::to_string(tid) : res;
+}
+
+std::string Symbolize(void *pc) {
+    /*返回地址指向call的下一条指令，减1后落在调用所在的函数内*/
+    void *addr = static_cast<char *>(pc) - 1;
+    Dl_info info;
+    if (dladdr(addr, &info) == 0) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%p", pc);
+        return buf;
+    }
+    if (info.dli_sname) {
+        int status = 0;
+        std::unique_ptr<char, void (*)(void *)> demangled(
+            abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status), free);
+        std::string name = (status == 0 && demangled) ? demangled.get() : info.dli_sname;
+        for (char &ch : name) {
+            if (ch == ';') { //';'是折叠栈的分隔符
+                ch = ':';
+            }
+        }
+        return name;
+    }
+    /*没有符号时输出模块名+偏移*/
+    const char *module = info.dli_fname ? strrchr(info.dli_fname, '/') : nullptr;
+    module = module ? module + 1 : (info.dli_fname ? info.dli_fname : "??");
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s+0x%zx", module,
+             static_cast<size_t>(static_cast<char *>(addr) - static_cast<char *>(info.dli_fbase)));
+    return buf;
+}
+
+} // namespace
+
+std::atomic<bool> Profiler::s_active(false);
+std::atomic<int> Profiler::s_inflight(0);
+std::atomic<size_t> Profiler::s_next(0);
+Profiler::Sample *Profiler::s_samples = nullptr;
+size_t Profiler::s_capacity = 0;
+
+Profiler *Profiler::Instance() {
+    static Profiler profiler;
+    return &profiler;
+}
+
+void Profiler::OnSignal(int) {
+    int savedErrno = errno;
+    /*与Profile中的停止过程构成Dekker式握手：先登记再检查s_active，对方先清s_active再检查s_inflight，
+     *两边都必须是seq_cst，否则store->load可能被重排(x86的store buffer就会)，双方都看不到对方的写，
+     *处理函数在缓冲区被聚合或释放之后仍然写入*/
+    s_inflight.fetch_add(1, std::memory_order_seq_cst);
+    if (s_active.load(std::memory_order_seq_cst)) {
+        size_t idx = s_next.fetch_add(1, std::memory_order_relaxed);
+        if (idx < s_capacity) {
+            Sample &s = s_samples[idx];
+            s.tid = static_cast<int>(syscall(SYS_gettid));
+            s.depth = backtrace(s.pcs, MAX_DEPTH);
+        }
+    }
+    s_inflight.fetch_sub(1, std::memory_order_release);
+    errno = savedErrno;
+}
+
+bool Profiler::Profile(int seconds, int hz, std::string &out) {
+    std::unique_lock<std::mutex> locker(m_mutex, std::try_to_lock);
+    if (!locker.owns_lock()) {
+        out = "profile already running\n";
+        return false;
+    }
+    seconds = seconds < 1 ? 1 : (seconds > MAX_SECONDS ? MAX_SECONDS : seconds);
+    hz = hz < 1 ? 1 : (hz > MAX_HZ ? MAX_HZ : hz);
+    /*ITIMER_PROF按整个进程的CPU时间计时，每个CPU每秒最多产生hz个样本*/
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t capacity = static_cast<size_t>(seconds) * hz * (cpus > 0 ? cpus : 1) + 64;
+    std::unique_ptr<Sample[]> samples(new Sample[capacity < MAX_SAMPLES ? capacity : MAX_SAMPLES]);
+    s_samples = samples.get();
+    s_capacity = capacity < MAX_SAMPLES ? capacity : MAX_SAMPLES;
+    s_next.store(0, std::memory_order_relaxed);
+
+    void *warmup[1];
+    backtrace(warmup, 1); //提前加载libgcc，避免在信号处理函数中分配内存
+    struct sigaction sa, old;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = OnSignal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, &old) < 0) {
+        LOG_ERROR("Profiler install SIGPROF handler error!");
+        out = "install SIGPROF handler error\n";
+        return false;
+    }
+    s_active.store(true, std::memory_order_release);
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = 1000000 / hz;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, nullptr) < 0) {
+        s_active.store(false, std::memory_order_release);
+        sigaction(SIGPROF, &old, nullptr);
+        LOG_ERROR("Profiler setitimer error!");
+        out = "setitimer error\n";
+        return false;
+    }
+    LOG_INFO("Profiler started, %ds at %dHz", seconds, hz);
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    s_active.store(false, std::memory_order_seq_cst);
+    /*等待已经进入信号处理函数的线程写完栈；之后进入的处理函数一定能看到s_active为false*/
+    while (s_inflight.load(std::memory_order_seq_cst) > 0) {
+        std::this_thread::yield();
+    }
+    /*保留处理函数而不恢复为默认动作，迟到的SIGPROF不会终止进程*/
+    size_t count = s_next.load(std::memory_order_relaxed);
+    size_t dropped = count > s_capacity ? count - s_capacity : 0;
+    count -= dropped;
+    out = Fold(count);
+    LOG_INFO("Profiler finished, %zu samples, %zu dropped", count, dropped);
+    s_samples = nullptr;
+    s_capacity = 0;
+    return true;
+}
+
+std::string Profiler::Fold(size_t count) {
+    std::unordered_map<void *, std::string> symbols; //同一地址只符号化一次
+    std::unordered_map<int, std::string> threads;
+    std::map<std::string, size_t> folded;
+    std::string stack;
+    for (size_t i = 0; i < count; i++) {
+        const Sample &s = s_samples[i];
+        if (threads.find(s.tid) == threads.end()) {
+            threads[s.tid] = ThreadName(s.tid);
+        }
+        stack = threads[s.tid];
+        /*backtrace从内向外，折叠栈从外向内*/
+        for (int j = s.depth - 1; j >= SKIP_FRAMES; j--) {
+            auto it = symbols.find(s.pcs[j]);
+            if (it == symbols.end()) {
+                it = symbols.emplace(s.pcs[j], Symbolize(s.pcs[j])).first;
+            }
+            stack += ';';
+            stack += it->second;
+        }
+        folded[stack]++;
+    }
+    std::string out;
+    for (const auto &kv : folded) {
+        out += kv.first;
+        out += ' ';
+        out += std::to_string(kv.second);
+        out += '\n';
+    }
+    return out;
+}
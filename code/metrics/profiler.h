@@ -0,0 +1,46 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+/*进程内的采样CPU分析器
+ *采样期间用setitimer(ITIMER_PROF)按进程消耗的CPU时间定时产生SIGPROF，内核把信号投递给正在运行的线程，
+ *信号处理函数只把该线程的调用栈写入预先分配好的槽位；采样结束后在调用线程中用dladdr符号化，
+ *按线程名和调用栈聚合，输出折叠栈格式(每行"线程;外层函数;...;内层函数 次数")，可直接交给flamegraph.pl绘制*/
+class Profiler
+{
+public:
+    static const int MAX_SECONDS = 60;
+    static const int MAX_HZ = 1000;
+
+    static Profiler *Instance();
+    /*阻塞采样seconds秒，结果写入out；已有采样在进行或初始化失败时返回false。
+     *管理端口在后台线程中调用，采样期间不影响/metrics等其他请求*/
+    bool Profile(int seconds, int hz, std::string &out);
+
+private:
+    static const int MAX_DEPTH = 64;
+    static const size_t MAX_SAMPLES = 65536;
+    struct Sample {
+        int tid;
+        int depth;
+        void *pcs[MAX_DEPTH];
+    };
+
+    static std::atomic<bool> s_active;
+    static std::atomic<int> s_inflight; //正在执行的信号处理函数数
+    static std::atomic<size_t> s_next;  //下一个空闲槽位
+    static Sample *s_samples;
+    static size_t s_capacity;
+    std::mutex m_mutex; //同一时刻只允许一次采样
+
+    Profiler() = default;
+    ~Profiler() = default;
+    static void OnSignal(int);
+    /*把采到的栈聚合为折叠栈文本*/
+    static std::string Fold(size_t count);
+};
+
+#endif // !PROFILER_H
@@ -0,0 +1,126 @@
+#include "tracer.h"
+#include <cstdio>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+const char *STAGE_NAME[Tracer::STAGE_NUM] = {"queue", "read", "parse", "db", "respond", "write"};
+
+struct Snapshot {
+    uint64_t id;
+    int64_t start;
+    int64_t end;
+    int stage;
+};
+
+} // namespace
+
+std::atomic<uint32_t> Tracer::s_sampleEvery(0);
+thread_local uint64_t Tracer::t_current = 0;
+thread_local Tracer::Ring *Tracer::t_ring = nullptr;
+
+Tracer::Ring::Ring(int tid) : tid(tid), head(0), events(new Event[RING_SIZE]) {
+    for (size_t i = 0; i < RING_SIZE; i++) {
+        events[i].seq.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Tracer::Ring::Push(uint64_t id, Stage stage, int64_t startNs, int64_t endNs) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    Event &e = events[h & (RING_SIZE - 1)];
+    e.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.id.store(id, std::memory_order_relaxed);
+    e.start.store(startNs, std::memory_order_relaxed);
+    e.end.store(endNs, std::memory_order_relaxed);
+    e.stage.store(stage, std::memory_order_relaxed);
+    e.seq.store(h + 1, std::memory_order_release);
+    head.store(h + 1, std::memory_order_release);
+}
+
+Tracer::Tracer() : m_requestSeq(0), m_nextId(1) {}
+
+Tracer *Tracer::Instance() {
+    static Tracer tracer;
+    return &tracer;
+}
+
+void Tracer::SetSampleEvery(uint32_t n) {
+    s_sampleEvery.store(n, std::memory_order_relaxed);
+}
+
+uint64_t Tracer::NextId(uint32_t every) {
+    if (m_requestSeq.fetch_add(1, std::memory_order_relaxed) % every != 0) {
+        return 0;
+    }
+    return m_nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+Tracer::Ring *Tracer::Register() {
+    std::unique_ptr<Ring> ring(new Ring(static_cast<int>(syscall(SYS_gettid))));
+    Ring *ptr = ring.get();
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_rings.push_back(std::move(ring));
+    return ptr;
+}
+
+void Tracer::Clear() {
+    std::lock_guard<std::mutex> locker(m_mutex);
+    for (auto &ring : m_rings) {
+        /*只作废序号，不改动head，避免与所属线程的写入冲突*/
+        for (size_t i = 0; i < RING_SIZE; i++) {
+            ring->events[i].seq.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::string Tracer::ExportChromeTrace() {
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    char line[512];
+    bool first = true;
+    std::lock_guard<std::mutex> locker(m_mutex);
+    for (size_t r = 0; r < m_rings.size(); r++) {
+        const Ring &ring = *m_rings[r];
+        snprintf(line, sizeof(line),
+                 "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"worker-%zu\"}}",
+                 first ? "" : ",", ring.tid, r);
+        out += line;
+        first = false;
+        uint64_t h = ring.head.load(std::memory_order_acquire);
+        uint64_t begin = h > RING_SIZE ? h - RING_SIZE : 0;
+        for (uint64_t i = begin; i < h; i++) {
+            const Event &e = ring.events[i & (RING_SIZE - 1)];
+            uint64_t seq = e.seq.load(std::memory_order_acquire);
+            Snapshot s;
+            s.id = e.id.load(std::memory_order_relaxed);
+            s.start = e.start.load(std::memory_order_relaxed);
+            s.end = e.end.load(std::memory_order_relaxed);
+            s.stage = e.stage.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            /*读取期间被覆盖或已被清空的事件丢弃*/
+            if (seq != i + 1 || e.seq.load(std::memory_order_relaxed) != seq || s.stage < 0 ||
+                s.stage >= STAGE_NUM) {
+                continue;
+            }
+            unsigned long long id = static_cast<unsigned long long>(s.id);
+            if (s.stage == QUEUE) {
+                /*排队期间工作线程可能在执行其他任务，用异步事件表示，避免与线程上的其他阶段交叠*/
+                snprintf(line, sizeof(line),
+                         ",\n{\"name\":\"queue\",\"cat\":\"request\",\"ph\":\"b\",\"id\":%llu,\"pid\":1,"
+                         "\"tid\":%d,\"ts\":%.3f,\"args\":{\"trace_id\":%llu}}"
+                         ",\n{\"name\":\"queue\",\"cat\":\"request\",\"ph\":\"e\",\"id\":%llu,\"pid\":1,"
+                         "\"tid\":%d,\"ts\":%.3f}",
+                         id, ring.tid, s.start / 1000.0, id, id, ring.tid, s.end / 1000.0);
+            } else {
+                snprintf(line, sizeof(line),
+                         ",\n{\"name\":\"%s\",\"cat\":\"request\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                         "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"trace_id\":%llu}}",
+                         STAGE_NAME[s.stage], ring.tid, s.start / 1000.0, (s.end - s.start) / 1000.0, id);
+            }
+            out += line;
+        }
+    }
+    out += "\n]}\n";
+    return out;
+}
@@ -0,0 +1,136 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "../utils/clock.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*按采样率追踪单个请求在各阶段的耗时
+ *每个请求开始解析时做一次采样决定并分配追踪id，工作线程在阶段边界把[开始,结束]写入本线程的环形缓冲区，
+ *缓冲区写满后覆盖最旧的事件；导出时在admin线程中读取所有缓冲区，生成Chrome trace格式的JSON，
+ *可在chrome://tracing或ui.perfetto.dev中打开。关闭采样时请求路径上只有一次原子读或线程局部变量读加分支*/
+class Tracer
+{
+public:
+    enum Stage {
+        QUEUE = 0, //从事件循环投递到工作线程开始执行
+        READ,      //从socket读取请求
+        PARSE,     //解析请求(包含其中的数据库访问)
+        DB,        //用户存储的登录、注册
+        RESPOND,   //生成响应(stat、open、mmap)
+        WRITE,     //向socket写响应
+        STAGE_NUM
+    };
+    static const size_t RING_SIZE = 8192; //每个线程保留的事件数，必须是2的幂
+
+    static Tracer *Instance();
+    /*每n个请求追踪一个，为0时关闭*/
+    void SetSampleEvery(uint32_t n);
+    uint32_t SampleEvery() const {
+        return s_sampleEvery.load(std::memory_order_relaxed);
+    }
+    /*为新请求做采样决定，返回0表示不追踪*/
+    static uint64_t Sample() {
+        uint32_t every = s_sampleEvery.load(std::memory_order_relaxed);
+        if (__builtin_expect(every == 0, 1)) {
+            return 0;
+        }
+        return Instance()->NextId(every);
+    }
+    /*当前线程正在处理的追踪id，供嵌套在其他阶段中的阶段(如数据库访问)使用*/
+    static void SetCurrent(uint64_t id) {
+        t_current = id;
+    }
+    static uint64_t Current() {
+        return t_current;
+    }
+    /*记录一个阶段，id为0时直接返回*/
+    static void Record(uint64_t id, Stage stage, int64_t startNs, int64_t endNs) {
+        if (id) {
+            Local()->Push(id, stage, startNs, endNs);
+        }
+    }
+    /*导出所有线程缓冲区中的事件*/
+    std::string ExportChromeTrace();
+    /*清空所有缓冲区*/
+    void Clear();
+
+private:
+    /*单个事件，seq作为顺序锁：写入前置0，写完后置为序号+1，读取端前后两次读到相同的非0值才有效*/
+    struct Event {
+        std::atomic<uint64_t> seq;
+        std::atomic<uint64_t> id;
+        std::atomic<int64_t> start;
+        std::atomic<int64_t> end;
+        std::atomic<int> stage;
+    };
+    struct Ring {
+        int tid;
+        std::atomic<uint64_t> head; //已写入的事件总数，只由所属线程修改
+        std::unique_ptr<Event[]> events;
+        explicit Ring(int tid);
+        void Push(uint64_t id, Stage stage, int64_t startNs, int64_t endNs);
+    };
+
+    static std::atomic<uint32_t> s_sampleEvery;
+    static thread_local uint64_t t_current; //本线程当前任务的追踪id
+    static thread_local Ring *t_ring;       //本线程的缓冲区，第一次记录时分配
+    std::atomic<uint64_t> m_requestSeq;     //参与采样的请求序号
+    std::atomic<uint64_t> m_nextId;
+    std::mutex m_mutex; //只保护缓冲区注册和导出
+    std::vector<std::unique_ptr<Ring>> m_rings;
+
+    Tracer();
+    ~Tracer() = default;
+    uint64_t NextId(uint32_t every);
+    static Ring *Local() {
+        if (!t_ring) {
+            t_ring = Instance()->Register();
+        }
+        return t_ring;
+    }
+    Ring *Register();
+};
+
+/*RAII：按当前线程的追踪id记录一个阶段，未采样时只有一次分支*/
+class TraceSpan
+{
+public:
+    explicit TraceSpan(Tracer::Stage stage)
+        : m_stage(stage), m_id(Tracer::Current()), m_start(m_id ? NowNs() : 0) {}
+    ~TraceSpan() {
+        if (m_id) {
+            Tracer::Record(m_id, m_stage, m_start, NowNs());
+        }
+    }
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    Tracer::Stage m_stage;
+    uint64_t m_id;
+    int64_t m_start;
+};
+
+/*RAII：工作线程执行一个任务期间设置当前追踪id，并记录任务的排队阶段*/
+class TraceContext
+{
+public:
+    TraceContext(uint64_t id, int64_t queuedNs, int64_t startNs) {
+        Tracer::SetCurrent(id);
+        if (id) {
+            Tracer::Record(id, Tracer::QUEUE, queuedNs, startNs);
+        }
+    }
+    ~TraceContext() {
+        Tracer::SetCurrent(0);
+    }
+    TraceContext(const TraceContext &) = delete;
+    TraceContext &operator=(const TraceContext &) = delete;
+};
+
+#endif // !TRACER_H
@@ -3,6 +3,7 @@
 SqlConnPool::SqlConnPool() {
     m_useCount = 0;
     m_freeCount = 0;
+    NameLock(m_mutex, "sql_conn_pool");
 }
 
 SqlConnPool::~SqlConnPool() {
@@ -40,29 +41,31 @@ MYSQL *SqlConnPool::GetConn() {
         LOG_ERROR("SqlConnPool busy!");
         return nullptr;
     }
+    int64_t start = NowNs();
     m_sem.Acquire();
     {
-        std::lock_guard<std::mutex> locker(m_mutex);
+        std::lock_guard<ServerMutex> locker(m_mutex);
         conn = m_connQue.front();
         m_connQue.pop();
     }
+    Metrics::Record(Metrics::SQL_WAIT, NowNs() - start);
     return conn;
 }
 
 void SqlConnPool::FreeConn(MYSQL *conn) {
     assert(conn);
-    std::lock_guard<std::mutex> locker(m_mutex);
+    std::lock_guard<ServerMutex> locker(m_mutex);
     m_connQue.push(conn);
     m_sem.Release();
 }
 
 int SqlConnPool::GetFreeConnCount() {
-    std::lock_guard<std::mutex> locker(m_mutex);
+    std::lock_guard<ServerMutex> locker(m_mutex);
     return m_connQue.size();
 }
 
 void SqlConnPool::ClosePool() {
-    std::lock_guard<std::mutex> locker(m_mutex);
+    std::lock_guard<ServerMutex> locker(m_mutex);
     while (!m_connQue.empty()) {
         auto item = m_connQue.front();
         m_connQue.pop();
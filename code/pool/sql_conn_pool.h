@@ -2,6 +2,7 @@
 #define SQL_CONN_POOL_H
 
 #include "../log/log.h"
+#include "../metrics/metrics.h"
 #include "../utils/semaphore.h"
 #include <cassert>
 #include <mutex>
@@ -15,7 +16,7 @@ private:
     int m_useCount;
     int m_freeCount;
     std::queue<MYSQL *> m_connQue;
-    std::mutex m_mutex;
+    ServerMutex m_mutex;
     Semaphore m_sem;
     SqlConnPool();
     ~SqlConnPool();
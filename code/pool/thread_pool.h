@@ -1,20 +1,36 @@
 #ifndef THREAD_POOL_H
 #define THREAD_POOL_H
+#include "../metrics/lock_stats.h"
+#include "../metrics/metrics.h"
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <condition_variable>
 #include <functional>
 #include <mutex>
+#include <pthread.h>
 #include <queue>
 #include <thread>
 
 class ThreadPool
 {
 private:
+    struct Task {
+        std::function<void()> func;
+        int64_t enqueueNs; //入队时刻，用于统计排队时间
+    };
     struct Pool {
-        std::mutex m_mutex;
-        std::condition_variable m_cond;
+        ServerMutex m_mutex;
+        ServerCondVar m_cond;
         bool m_isClosed;
-        std::queue<std::function<void()>> m_tasks;
+        std::queue<Task> m_tasks;
+        /*供准入控制无锁读取的队列状态*/
+        std::atomic<size_t> m_pending;     //队列中等待的任务数
+        std::atomic<int64_t> m_lastWaitNs; //最近取出的任务的排队时间
+        std::atomic<int64_t> m_minWaitNs;  //上次TakeMinWait以来取出的任务中最短的排队时间
+        Pool() : m_isClosed(false), m_pending(0), m_lastWaitNs(0), m_minWaitNs(INT64_MAX) {
+            NameLock(m_mutex, "threadpool");
+        }
     };
     std::shared_ptr<Pool> m_pool;
 
@@ -25,14 +41,23 @@ public:
         for (size_t i = 0; i < threadCount; i++) {
             std::thread([pool = m_pool] {
                 /*工作线程运行的函数，它不断从任务队列中取出任务并执行*/
-                std::unique_lock<std::mutex> locker(pool->m_mutex);
+                pthread_setname_np(pthread_self(), "worker"); //线程名用于性能分析时区分线程
+                std::unique_lock<ServerMutex> locker(pool->m_mutex);
                 while (true) {
                     if (!pool->m_tasks.empty()) {
                         // std::move将资源的所有权从一个对象转移到另一个对象，而不需要进行深拷贝操作
                         auto task = std::move(pool->m_tasks.front());
                         pool->m_tasks.pop();
+                        pool->m_pending.fetch_sub(1, std::memory_order_relaxed);
                         locker.unlock(); // 因为已经把任务取出来了，所以可以提前解锁了
-                        task();
+                        int64_t wait = NowNs() - task.enqueueNs;
+                        Metrics::Record(Metrics::QUEUE_WAIT, wait);
+                        pool->m_lastWaitNs.store(wait, std::memory_order_relaxed);
+                        int64_t minWait = pool->m_minWaitNs.load(std::memory_order_relaxed);
+                        while (wait < minWait && !pool->m_minWaitNs.compare_exchange_weak(
+                                                     minWait, wait, std::memory_order_relaxed)) {
+                        }
+                        task.func();
                         locker.lock(); // 马上又要取任务了，上锁
                     } else if (pool->m_isClosed) {
                         break;
@@ -51,7 +76,7 @@ public:
     ~ThreadPool() {
         if (static_cast<bool>(m_pool)) {
             {
-                std::lock_guard<std::mutex> locker(m_pool->m_mutex);
+                std::lock_guard<ServerMutex> locker(m_pool->m_mutex);
                 m_pool->m_isClosed = true;
             }
             m_pool->m_cond.notify_all();
@@ -61,11 +86,27 @@ public:
     template <typename T>
     void AddTask(T &&task) {
         {
-            std::unique_lock<std::mutex> locker(m_pool->m_mutex);
-            m_pool->m_tasks.emplace(std::forward<T>(task));
+            std::unique_lock<ServerMutex> locker(m_pool->m_mutex);
+            m_pool->m_tasks.push({std::forward<T>(task), NowNs()});
+            m_pool->m_pending.fetch_add(1, std::memory_order_relaxed);
         }
         m_pool->m_cond.notify_one();
     }
+
+    /*队列中等待执行的任务数*/
+    size_t QueueSize() const {
+        return m_pool->m_pending.load(std::memory_order_relaxed);
+    }
+
+    /*最近取出的任务的排队时间(纳秒)*/
+    int64_t LastWaitNs() const {
+        return m_pool->m_lastWaitNs.load(std::memory_order_relaxed);
+    }
+
+    /*返回上次调用以来取出的任务中最短的排队时间并重新开始统计，期间没有任务被取出时返回INT64_MAX*/
+    int64_t TakeMinWaitNs() {
+        return m_pool->m_minWaitNs.exchange(INT64_MAX, std::memory_order_relaxed);
+    }
 };
 
 #endif // !THREAD_POOL_H
\ No newline at end of file
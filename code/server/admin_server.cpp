@@ -0,0 +1,188 @@
+#include "admin_server.h"
+#include "../log/log.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+AdminServer::AdminServer() : m_listenFd(-1), m_bgBusy(false) {
+    m_wakeFd[0] = m_wakeFd[1] = -1;
+}
+
+AdminServer::~AdminServer() {
+    Stop();
+}
+
+void AdminServer::AddRoute(const std::string &path, const std::string &contentType, Handler handler,
+                           bool background) {
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_routes[path] = {contentType, std::move(handler), background};
+}
+
+bool AdminServer::Start(const char *addr, int port) {
+    struct sockaddr_in sa = {0};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    if (inet_pton(AF_INET, addr, &sa.sin_addr) != 1) {
+        LOG_ERROR("Admin addr:%s error!", addr);
+        return false;
+    }
+    m_listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_listenFd < 0) {
+        LOG_ERROR("Create admin socket error!");
+        return false;
+    }
+    int optval = 1;
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+    if (bind(m_listenFd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(m_listenFd, 16) < 0) {
+        LOG_ERROR("Bind admin port:%d error!", port);
+        close(m_listenFd);
+        m_listenFd = -1;
+        return false;
+    }
+    if (pipe2(m_wakeFd, O_CLOEXEC) < 0) {
+        close(m_listenFd);
+        m_listenFd = -1;
+        return false;
+    }
+    m_thread = std::thread(&AdminServer::Loop, this);
+    LOG_INFO("Admin server %s:%d", addr, port);
+    return true;
+}
+
+void AdminServer::Stop() {
+    if (m_thread.joinable()) {
+        char c = 0;
+        ssize_t ret = write(m_wakeFd[1], &c, 1);
+        (void)ret;
+        m_thread.join();
+    }
+    if (m_bgThread.joinable()) {
+        m_bgThread.join(); //等待正在执行的后台请求完成
+    }
+    for (int fd : {m_listenFd, m_wakeFd[0], m_wakeFd[1]}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    m_listenFd = m_wakeFd[0] = m_wakeFd[1] = -1;
+}
+
+std::string AdminServer::QueryParam(const std::string &query, const std::string &key) {
+    size_t pos = 0;
+    while (pos < query.size()) {
+        size_t amp = query.find('&', pos);
+        if (amp == std::string::npos) {
+            amp = query.size();
+        }
+        size_t eq = query.find('=', pos);
+        if (eq != std::string::npos && eq < amp && query.compare(pos, eq - pos, key) == 0) {
+            return query.substr(eq + 1, amp - eq - 1);
+        }
+        pos = amp + 1;
+    }
+    return "";
+}
+
+void AdminServer::Loop() {
+    pthread_setname_np(pthread_self(), "admin");
+    struct pollfd fds[2];
+    fds[0].fd = m_listenFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_wakeFd[0];
+    fds[1].events = POLLIN;
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            continue;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0 && !HandleClient(fd)) {
+                close(fd);
+            }
+        }
+    }
+}
+
+bool AdminServer::HandleClient(int fd) {
+    /*管理请求很小，设置收发超时，避免慢客户端卡住服务线程*/
+    struct timeval tv = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    std::string req;
+    char buf[1024];
+    while (req.find("\r\n\r\n") == std::string::npos && req.size() < 8192) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            return false;
+        }
+        req.append(buf, n);
+    }
+    /*请求行：GET /path?query HTTP/1.1*/
+    size_t sp1 = req.find(' ');
+    size_t sp2 = sp1 == std::string::npos ? std::string::npos : req.find(' ', sp1 + 1);
+    if (sp2 == std::string::npos || req.compare(0, sp1, "GET") != 0) {
+        SendResponse(fd, 400, "Bad Request", "text/plain", "bad request\n");
+        return false;
+    }
+    std::string target = req.substr(sp1 + 1, sp2 - sp1 - 1);
+    size_t qmark = target.find('?');
+    std::string path = target.substr(0, qmark);
+    std::string query = qmark == std::string::npos ? "" : target.substr(qmark + 1);
+    Route route;
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        auto it = m_routes.find(path);
+        if (it == m_routes.end()) {
+            std::string body = "not found, available:";
+            for (const auto &item : m_routes) {
+                body += " " + item.first;
+            }
+            SendResponse(fd, 404, "Not Found", "text/plain", body + "\n");
+            return false;
+        }
+        route = it->second;
+    }
+    if (route.background) {
+        if (m_bgBusy.exchange(true)) {
+            SendResponse(fd, 503, "Service Unavailable", "text/plain", "another request is running\n");
+            return false;
+        }
+        if (m_bgThread.joinable()) {
+            m_bgThread.join(); //上一个后台请求已经结束
+        }
+        m_bgThread = std::thread([this, fd, route, query] {
+            pthread_setname_np(pthread_self(), "admin-bg");
+            SendResponse(fd, 200, "OK", route.contentType, route.handler(query));
+            close(fd);
+            m_bgBusy = false;
+        });
+        return true;
+    }
+    SendResponse(fd, 200, "OK", route.contentType, route.handler(query));
+    return false;
+}
+
+void AdminServer::SendResponse(int fd, int code, const char *status, const std::string &contentType,
+                               const std::string &body) {
+    std::string head = "HTTP/1.1 " + std::to_string(code) + " " + status + "\r\n";
+    head += "Content-Type: " + contentType + "\r\n";
+    head += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    head += "Connection: close\r\n\r\n";
+    head += body;
+    size_t off = 0;
+    while (off < head.size()) {
+        ssize_t n = send(fd, head.data() + off, head.size() - off, MSG_NOSIGNAL);
+        if (n <= 0) {
+            LOG_WARN("Admin response to client[%d] error", fd);
+            return;
+        }
+        off += n;
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef ADMIN_SERVER_H
+#define ADMIN_SERVER_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*管理端口：在独立线程中以阻塞方式逐个处理简单的HTTP GET请求，
+ *用于指标抓取等运维操作，不占用事件循环和线程池*/
+class AdminServer
+{
+public:
+    /*query为URL中?之后的部分，返回响应消息体*/
+    typedef std::function<std::string(const std::string &query)> Handler;
+
+    AdminServer();
+    ~AdminServer();
+    /*注册路由，path形如"/metrics"；background为true时处理函数在后台线程中执行，
+     *耗时的请求(如/profile)不阻塞其他管理请求，同一时刻只执行一个，重叠的请求返回503*/
+    void AddRoute(const std::string &path, const std::string &contentType, Handler handler, bool background = false);
+    /*绑定地址并启动服务线程*/
+    bool Start(const char *addr, int port);
+    void Stop();
+    /*从query中取出key对应的值，不存在时返回空串*/
+    static std::string QueryParam(const std::string &query, const std::string &key);
+
+private:
+    struct Route {
+        std::string contentType;
+        Handler handler;
+        bool background;
+    };
+    int m_listenFd;
+    int m_wakeFd[2]; //用于通知服务线程退出
+    std::thread m_thread;
+    std::thread m_bgThread;      //执行后台路由的线程
+    std::atomic<bool> m_bgBusy; //后台路由正在执行
+    std::mutex m_mutex;
+    std::map<std::string, Route> m_routes;
+
+    void Loop();
+    /*处理一个管理请求；返回true表示fd已交给后台线程，由它负责关闭*/
+    bool HandleClient(int fd);
+    static void SendResponse(int fd, int code, const char *status, const std::string &contentType,
+                             const std::string &body);
+};
+
+#endif // !ADMIN_SERVER_H
@@ -0,0 +1,35 @@
+#include "admission.h"
+#include "../log/log.h"
+
+AdmissionControl::AdmissionControl(ThreadPool *pool, int64_t targetNs, int64_t intervalNs, size_t maxQueue)
+    : m_pool(pool), m_targetNs(targetNs), m_intervalNs(intervalNs), m_maxQueue(maxQueue), m_intervalEnd(0),
+      m_overloaded(false) {
+    assert(pool && targetNs >= 0 && intervalNs > 0);
+}
+
+bool AdmissionControl::Admit(int64_t nowNs) {
+    size_t depth = m_pool->QueueSize();
+    if (m_maxQueue > 0 && depth >= m_maxQueue) {
+        return false;
+    }
+    if (m_targetNs == 0) {
+        return true;
+    }
+    if (nowNs >= m_intervalEnd) {
+        int64_t minWait = m_pool->TakeMinWaitNs();
+        /*整个周期没有任务被取出：队列中有任务说明工作线程全部卡住，否则只是空闲*/
+        bool standing = (minWait == INT64_MAX) ? depth > 0 : minWait > m_targetNs;
+        if (m_intervalEnd != 0 && standing != Overloaded()) {
+            m_overloaded.store(standing, std::memory_order_relaxed);
+            if (standing) {
+                LOG_WARN("Overloaded: queue wait %.1fms over target %.1fms, queue depth %zu, shedding requests",
+                         (minWait == INT64_MAX ? 0 : minWait) / 1e6, m_targetNs / 1e6, depth);
+            } else {
+                LOG_INFO("Overload cleared, queue depth %zu", depth);
+            }
+        }
+        m_intervalEnd = nowNs + m_intervalNs;
+    }
+    /*队列已空时最近一次排队时间可能是积压时的旧值，直接接收*/
+    return !Overloaded() || depth == 0 || m_pool->LastWaitNs() <= m_targetNs;
+}
@@ -0,0 +1,33 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include "../pool/thread_pool.h"
+#include <atomic>
+#include <cstdint>
+
+/*基于线程池排队时间的准入控制(参照CoDel)
+ *检测：一个统计周期内取出的任务中最短的排队时间仍超过目标值，说明队列是持续存在的积压而不是瞬时突发，进入过载状态；
+ *控制：过载期间最近一次排队时间超过目标值就拒绝新请求，积压消化后立即恢复接收；
+ *某个统计周期内最短排队时间回落到目标值以下时退出过载状态。
+ *另外队列长度达到上限时无条件拒绝。只在事件循环线程中调用Admit*/
+class AdmissionControl
+{
+public:
+    /*targetNs为0时不按排队时间拒绝，maxQueue为0时不限制队列长度*/
+    AdmissionControl(ThreadPool *pool, int64_t targetNs, int64_t intervalNs, size_t maxQueue);
+    /*请求交给线程池之前调用，返回false表示应当拒绝*/
+    bool Admit(int64_t nowNs);
+    bool Overloaded() const {
+        return m_overloaded.load(std::memory_order_relaxed);
+    }
+
+private:
+    ThreadPool *m_pool;
+    int64_t m_targetNs;
+    int64_t m_intervalNs;
+    size_t m_maxQueue;
+    int64_t m_intervalEnd; //当前统计周期的结束时间
+    std::atomic<bool> m_overloaded;
+};
+
+#endif // !ADMISSION_H
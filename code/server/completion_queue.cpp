@@ -0,0 +1,39 @@
+#include "completion_queue.h"
+#include "../log/log.h"
+#include "../metrics/metrics.h"
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+
+CompletionQueue::CompletionQueue(size_t capacity)
+    : m_ring(capacity), m_eventFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), m_wakePending(false) {
+    assert(m_eventFd >= 0);
+}
+
+CompletionQueue::~CompletionQueue() {
+    close(m_eventFd);
+}
+
+void CompletionQueue::Post(int fd, Action action) {
+    while (!m_ring.Push({fd, action})) {
+        /*正常情况下不会发生，等待事件循环取走*/
+        LOG_WARN("Completion queue full!");
+        std::this_thread::yield();
+    }
+    if (!m_wakePending.exchange(true)) {
+        uint64_t one = 1;
+        if (write(m_eventFd, &one, sizeof(one)) < 0) {
+            LOG_WARN("Completion queue wakeup error!");
+        }
+        Metrics::Add(Metrics::LOOP_WAKEUPS);
+    }
+}
+
+void CompletionQueue::OnWakeup() {
+    uint64_t count;
+    if (read(m_eventFd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        LOG_WARN("Completion queue read eventfd error!");
+    }
+    /*先清除标记再取队列：之后投递的通知会重新唤醒，之前投递的在本轮被取走*/
+    m_wakePending.store(false);
+}
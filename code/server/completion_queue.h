@@ -0,0 +1,45 @@
+#ifndef COMPLETION_QUEUE_H
+#define COMPLETION_QUEUE_H
+
+#include "../utils/mpsc_ring.h"
+#include <atomic>
+
+/*工作线程处理完连接后向事件循环投递的完成通知
+ *工作线程不再直接调用epoll_ctl、关闭连接或访问定时器，这些操作都由事件循环在取出通知后执行；
+ *通知写入无锁队列，必要时写eventfd唤醒阻塞在epoll_wait上的事件循环*/
+class CompletionQueue
+{
+public:
+    enum Action {
+        REARM_READ,  //重新监听可读
+        REARM_WRITE, //响应没有写完，监听可写
+        CLOSE,       //关闭连接
+    };
+    struct Completion {
+        int fd;
+        Action action;
+    };
+
+    /*每个连接同一时刻最多有一个未取出的通知，容量不小于最大连接数时队列不会满*/
+    explicit CompletionQueue(size_t capacity);
+    ~CompletionQueue();
+    /*注册到epoll中的eventfd*/
+    int Fd() const {
+        return m_eventFd;
+    }
+    /*工作线程调用*/
+    void Post(int fd, Action action);
+    /*事件循环在eventfd可读时调用，之后必须取空队列*/
+    void OnWakeup();
+    /*只能在事件循环中调用*/
+    bool Pop(Completion &completion) {
+        return m_ring.Pop(completion);
+    }
+
+private:
+    MpscRing<Completion> m_ring;
+    int m_eventFd;
+    std::atomic<bool> m_wakePending; //已写过eventfd而事件循环还没有响应，期间的通知不必再唤醒
+};
+
+#endif // !COMPLETION_QUEUE_H
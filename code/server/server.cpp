@@ -3,9 +3,15 @@
 using namespace std;
 
 Server::Server(int port, int trigMode, int timeoutMS, bool Linger, int sqlPort, const char *sqlUser, const char *sqlPwd,
-               const char *dbName, int connPoolNum, int threadNum, bool openLog, int logLevel, int logQueSize)
+               const char *dbName, int connPoolNum, int threadNum, bool openLog, int logLevel, int logQueSize,
+               const ServerConfig &config)
     : m_port(port), m_openLinger(Linger), m_timeoutMs(timeoutMS), m_isClosed(false), m_timer(new HeapTimer()),
-      m_threadPool(new ThreadPool(threadNum)), m_epoller(new Epoller()) {
+      m_completions(new CompletionQueue(MAX_FD)), m_threadPool(new ThreadPool(threadNum)), m_epoller(new Epoller()),
+      m_watchdog(new Watchdog()),
+      m_loopStallNs(static_cast<int64_t>(config.loopStallMs) * 1000000), m_socket(config.socket),
+      m_acceptBatch(config.acceptBatch), m_acceptPending(false), m_idleFd(open("/dev/null", O_RDONLY | O_CLOEXEC)),
+      m_inlineMaxBytes(config.fileCacheBytes > 0 ? std::min(config.inlineMaxBytes, config.fileCacheMaxFile) : 0) {
+    assert(m_acceptBatch > 0);
     /*获取当前工作目录的路径,若传入的 buf 为 NULL，且 size 为 0，则
      *getcwd()内部会按需分配一个缓冲区，并将指向该缓冲区的指针作为函数的返回值
      *调用者使用完之后必须调用 free()来释放这一缓冲区所占内存空间*/
@@ -14,9 +20,38 @@ Server::Server(int port, int trigMode, int timeoutMS, bool Linger, int sqlPort,
     strncat(m_srcDir, "/resources/", 16);
     HttpConn::userCount = 0; //初始化静态成员
     HttpConn::srcDir = m_srcDir;
-    SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum); //初始化数据库连接池
+    if (config.userStore == "memory") {
+        m_userStore.reset(new MemoryUserStore(config.userStoreLatencyUs)); //进程内用户存储，不连接数据库
+    } else {
+        SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum); //初始化数据库连接池
+        m_userStore.reset(new MysqlUserStore());
+    }
+    HttpRequest::userStore = m_userStore.get();
+    HttpRequest::maxBodyBytes = config.maxBodyBytes;
+    HttpRequest::bodyTmpDir = config.bodyTmpDir;
+    Tracer::Instance()->SetSampleEvery(config.traceSampleEvery);
+    LockStats::SetEnabled(config.lockStats);
+    HttpConn::useCork = m_socket.cork;
+    FileCache::Instance()->Init(config.fileCacheBytes, config.fileCacheMaxFile);
+    FileCache::Encoded()->Init(config.compressCacheBytes, config.compressMaxFile);
+    FileCache::Headers()->Init(config.headerCacheBytes, 0);
+    for (const auto &item : config.cacheControl) {
+        HttpResponse::cacheControl[item.first] = item.second;
+    }
+    assert(config.writeLowWater <= config.writeHighWater && config.writeBudget > 0);
+    HttpConn::highWater = config.writeHighWater;
+    HttpConn::lowWater = config.writeLowWater;
+    HttpConn::writeBudget = config.writeBudget;
+    m_admission.reset(new AdmissionControl(m_threadPool.get(), static_cast<int64_t>(config.overloadTargetMs) * 1000000,
+                                           static_cast<int64_t>(config.overloadIntervalMs) * 1000000,
+                                           config.overloadMaxQueue));
+    const char *busyBody = "<html><title>503</title><body>Server busy, please retry later.</body></html>";
+    m_busyResponse = "HTTP/1.1 503 Service Unavailable\r\nContent-Type: text/html\r\nContent-Length: " +
+                     std::to_string(strlen(busyBody)) + "\r\nRetry-After: " + std::to_string(config.retryAfterSec) +
+                     "\r\nConnection: close\r\n\r\n" + busyBody;
+    HttpConn::slowRequestNs = static_cast<int64_t>(config.slowRequestMs) * 1000000;
     InitEventMode(trigMode);                                                                   //初始化事件
-    if (!InitSocket()) {
+    if (!InitSocket() || !m_epoller->AddFd(m_completions->Fd(), EPOLLIN)) {
         m_isClosed = true;
     }
     if (openLog) {
@@ -29,19 +64,130 @@ Server::Server(int port, int trigMode, int timeoutMS, bool Linger, int sqlPort,
             LOG_INFO("Listen Mode:%s,OpenConn Mode:%s", (m_listenEvent & EPOLLET ? "ET" : "LT"),
                      (m_connEvent & EPOLLET ? "ER" : "LT"));
             LOG_INFO("LogSys level:%d", logLevel);
+            LOG_INFO("Overload target:%dms, interval:%dms, max queue:%zu", config.overloadTargetMs,
+                     config.overloadIntervalMs, config.overloadMaxQueue);
+            LOG_INFO("Socket backlog:%d, DeferAccept:%ds, FastOpen:%d, NoDelay:%s, Cork:%s, SndBuf:%d, RcvBuf:%d",
+                     m_socket.backlog, m_socket.deferAcceptSec, m_socket.fastOpenQueue,
+                     m_socket.noDelay ? "true" : "false", m_socket.cork ? "true" : "false", m_socket.sndBuf,
+                     m_socket.rcvBuf);
+            LOG_INFO("Slow request threshold:%dms", config.slowRequestMs);
+            LOG_INFO("Write high water:%zuKB, low water:%zuKB, budget:%zuKB", config.writeHighWater >> 10,
+                     config.writeLowWater >> 10, config.writeBudget >> 10);
+            LOG_INFO("File cache:%zuMB, max file:%zuKB, inline max:%zuKB", config.fileCacheBytes >> 20,
+                     config.fileCacheMaxFile >> 10, m_inlineMaxBytes >> 10);
+            LOG_INFO("Compress cache:%zuMB, max file:%zuKB", config.compressCacheBytes >> 20,
+                     config.compressMaxFile >> 10);
+            LOG_INFO("Max body:%zuMB, body temp dir:%s", config.maxBodyBytes >> 20, config.bodyTmpDir.c_str());
             LOG_INFO("srcDir:%s", HttpConn::srcDir);
-            LOG_INFO("SqlConnPool num:%d, ThreadPool num:%d", connPoolNum, threadNum);
+            LOG_INFO("UserStore:%s, SqlConnPool num:%d, ThreadPool num:%d", m_userStore->Name(), connPoolNum,
+                     threadNum);
+        }
+    }
+    /*资源包在日志初始化之后加载，以便记录加载失败的原因；指定了资源包却加载失败时不启动*/
+    if (!m_isClosed && !config.packFile.empty()) {
+        AssetPack *pack = AssetPack::Instance();
+        if (pack->Open(config.packFile, m_srcDir, config.packPopulate, config.packHugePages)) {
+            LOG_INFO("Asset pack:%s, %u entries, %zu bytes, populate:%s, hugepages:%s", config.packFile.c_str(),
+                     pack->Count(), pack->Bytes(), config.packPopulate ? "true" : "false",
+                     config.packHugePages ? "true" : "false");
+        } else {
+            m_isClosed = true;
         }
     }
+    /*资源包已整个映射，不再需要预热resources目录；命中列表仍然记录，以便之后不用资源包启动时使用*/
+    if (!m_isClosed && config.warmupBytes > 0 && !AssetPack::Instance()->Active()) {
+        Warmup::Instance()->Run(m_srcDir, config.hitListFile, config.warmupBytes, config.warmupLockBytes);
+    }
+    if (!m_isClosed && !config.hitListFile.empty()) {
+        Warmup::Instance()->StartSaver(config.hitListFile, config.hitListIntervalSec);
+    }
+    /*日志初始化之后再加载用户名过滤器，以便记录加载耗时和内存占用；
+     *在管理线程启动之前加载，指标回调读取时过滤器已不再变化*/
+    MysqlUserStore *mysqlStore = dynamic_cast<MysqlUserStore *>(m_userStore.get());
+    if (!m_isClosed && mysqlStore && !mysqlStore->InitUserFilter(config.userFilterCapacity, config.userFilterFpRate)) {
+        LOG_WARN("UserFilter disabled, register will always query user table");
+    }
+    if (!m_isClosed && config.adminPort > 0) {
+        InitAdmin(config);
+    }
 }
 
 Server::~Server() {
+    m_admin.reset(); //先停止管理线程，其中的指标回调引用了本对象
+    m_watchdog->Stop();
+    Warmup::Instance()->Stop(); //保存最后的命中列表
     close(m_listenFd);
+    close(m_idleFd);
     m_isClosed = true;
     free(m_srcDir);
     SqlConnPool::Instance()->ClosePool();
 }
 
+void Server::InitAdmin(const ServerConfig &config) {
+    Metrics *metrics = Metrics::Instance();
+    metrics->AddGauge("webserver_active_connections", "Open client connections.",
+                      [] { return static_cast<double>(HttpConn::userCount); });
+    metrics->AddGauge("webserver_threadpool_queue_depth", "Tasks waiting in the ThreadPool queue.",
+                      [this] { return static_cast<double>(m_threadPool->QueueSize()); });
+    metrics->AddGauge("webserver_outgoing_bytes", "Response bytes queued on all connections.",
+                      [] { return static_cast<double>(HttpConn::outgoingBytes.load()); });
+    metrics->AddGauge("webserver_file_cache_bytes", "Bytes held by the small file cache.",
+                      [] { return static_cast<double>(FileCache::Instance()->Bytes()); });
+    metrics->AddGauge("webserver_encoded_cache_bytes", "Bytes held by the cache of compressed responses.",
+                      [] { return static_cast<double>(FileCache::Encoded()->Bytes()); });
+    metrics->AddGauge("webserver_overloaded", "1 while the server is shedding requests.",
+                      [this] { return m_admission->Overloaded() ? 1.0 : 0.0; });
+    if (const MysqlUserStore *mysqlStore = dynamic_cast<const MysqlUserStore *>(m_userStore.get())) {
+        metrics->AddGauge("webserver_user_filter_bytes", "Memory used by the registered username bloom filter.",
+                          [mysqlStore] { return static_cast<double>(mysqlStore->UserFilterBytes()); });
+        metrics->AddGauge("webserver_user_filter_load_seconds", "Time spent loading the username bloom filter.",
+                          [mysqlStore] { return mysqlStore->UserFilterLoadMs() / 1e3; });
+    }
+    m_admin.reset(new AdminServer());
+    m_admin->AddRoute("/metrics", "text/plain; version=0.0.4",
+                      [](const std::string &) { return Metrics::Instance()->Scrape() + LockStats::Instance()->Scrape(); });
+    /*GET /locks查看锁统计；/locks?enable=1|0运行时开关，/locks?reset=1清零*/
+    m_admin->AddRoute("/locks", "text/plain", [](const std::string &query) {
+        std::string enable = AdminServer::QueryParam(query, "enable");
+        if (!enable.empty()) {
+            LockStats::SetEnabled(enable == "1");
+            LOG_INFO("Lock stats %s", LockStats::Enabled() ? "enabled" : "disabled");
+        }
+        if (AdminServer::QueryParam(query, "reset") == "1") {
+            LockStats::Instance()->Reset();
+        }
+        return LockStats::Instance()->Report();
+    });
+    /*GET /trace导出追踪事件；/trace?sample=N修改采样率(0关闭)，/trace?clear=1清空缓冲区*/
+    m_admin->AddRoute("/trace", "application/json", [](const std::string &query) {
+        Tracer *tracer = Tracer::Instance();
+        std::string sample = AdminServer::QueryParam(query, "sample");
+        if (!sample.empty()) {
+            tracer->SetSampleEvery(static_cast<uint32_t>(strtoul(sample.c_str(), nullptr, 10)));
+            LOG_INFO("Trace sample every %u requests", tracer->SampleEvery());
+            return "{\"sample_every\":" + std::to_string(tracer->SampleEvery()) + "}\n";
+        }
+        if (AdminServer::QueryParam(query, "clear") == "1") {
+            tracer->Clear();
+            return std::string("{\"cleared\":true}\n");
+        }
+        return tracer->ExportChromeTrace();
+    });
+    /*GET /profile?seconds=N&hz=H：采样N秒(默认10)，返回折叠栈，可用flamegraph.pl生成火焰图；
+     *在后台线程中执行，采样期间/metrics照常响应*/
+    m_admin->AddRoute("/profile", "text/plain", [](const std::string &query) {
+        std::string seconds = AdminServer::QueryParam(query, "seconds");
+        std::string hz = AdminServer::QueryParam(query, "hz");
+        std::string out;
+        Profiler::Instance()->Profile(seconds.empty() ? 10 : atoi(seconds.c_str()), hz.empty() ? 99 : atoi(hz.c_str()),
+                                      out);
+        return out;
+    }, true);
+    if (!m_admin->Start(config.adminAddr.c_str(), config.adminPort)) {
+        m_admin.reset();
+    }
+}
+
 void Server::InitEventMode(int trigMode) {
     m_listenEvent = EPOLLRDHUP; // EPOLLRDHUP来判断是否对端已经关闭，这样可以减少一次系统调用
     m_connEvent =
@@ -83,7 +229,7 @@ bool Server::InitSocket() {
         optLinger.l_onoff = 1;
         optLinger.l_linger = 1; //内核延迟一段时间
     }
-    m_listenFd = socket(PF_INET, SOCK_STREAM, 0);
+    m_listenFd = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (m_listenFd < 0) {
         LOG_ERROR("Create socket error!");
         return false;
@@ -107,13 +253,14 @@ bool Server::InitSocket() {
         close(m_listenFd);
         return false;
     }
+    ApplyListenOptions(); //接收缓冲区必须在listen之前设置，才能协商窗口扩大因子
     ret = bind(m_listenFd, (struct sockaddr *)&addr, sizeof(addr));
     if (ret < 0) {
         LOG_ERROR("Bind port:%d error!", m_port);
         close(m_listenFd);
         return false;
     }
-    ret = listen(m_listenFd, 6);
+    ret = listen(m_listenFd, m_socket.backlog);
     if (ret < 0) {
         LOG_ERROR("Listen port:%d error!", m_port);
         close(m_listenFd);
@@ -125,54 +272,145 @@ bool Server::InitSocket() {
         close(m_listenFd);
         return false;
     }
-    SetFdNonBlock(m_listenFd);
     LOG_INFO("Server port:%d", m_port);
     return true;
 }
 
-int Server::SetFdNonBlock(int fd) {
-    assert(fd > 0);
-    int oldOption = fcntl(fd, F_GETFL);
-    int newOption = oldOption | O_NONBLOCK;
-    return fcntl(fd, F_SETFL, newOption);
+void Server::ApplyListenOptions() {
+    if (m_socket.sndBuf > 0 && setsockopt(m_listenFd, SOL_SOCKET, SO_SNDBUF, &m_socket.sndBuf, sizeof(int)) < 0) {
+        LOG_WARN("Set socket SNDBUF error!");
+    }
+    if (m_socket.rcvBuf > 0 && setsockopt(m_listenFd, SOL_SOCKET, SO_RCVBUF, &m_socket.rcvBuf, sizeof(int)) < 0) {
+        LOG_WARN("Set socket RCVBUF error!");
+    }
+    if (m_socket.deferAcceptSec > 0 &&
+        setsockopt(m_listenFd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &m_socket.deferAcceptSec, sizeof(int)) < 0) {
+        LOG_WARN("Set socket DEFER_ACCEPT error!");
+    }
+    if (m_socket.fastOpenQueue > 0 &&
+        setsockopt(m_listenFd, IPPROTO_TCP, TCP_FASTOPEN, &m_socket.fastOpenQueue, sizeof(int)) < 0) {
+        LOG_WARN("Set socket FASTOPEN error!");
+    }
 }
 
 void Server::ProcessListen() {
     struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
-    do {
-        int connfd = accept(m_listenFd, (struct sockaddr *)&addr, &len);
-        if (connfd <= 0)
+    /*每轮最多接受m_acceptBatch个连接，避免连接风暴时已建立的连接得不到处理；
+     *accept4直接返回非阻塞、CLOEXEC的fd，省去两次fcntl*/
+    for (int i = 0; i < m_acceptBatch; i++) {
+        socklen_t len = sizeof(addr);
+        int connfd = accept4(m_listenFd, (struct sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (connfd < 0) {
+            if (errno == EMFILE || errno == ENFILE) {
+                /*fd耗尽时连接会一直留在队列中，LT模式下会不停触发，用预留的fd接受后立即关闭*/
+                LOG_WARN("Accept error: too many open files!");
+                close(m_idleFd);
+                m_idleFd = accept(m_listenFd, nullptr, nullptr);
+                if (m_idleFd >= 0) {
+                    close(m_idleFd);
+                }
+                m_idleFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+            }
+            m_acceptPending = false; //队列已取空(EAGAIN)或出错，等待下一次通知
             return;
-        else if (HttpConn::userCount >= MAX_FD) { //用户超出系统限制
-            SendError(connfd, "Server busy!");
+        } else if (HttpConn::userCount >= MAX_FD) { //用户超出系统限制
+            SendBusy(connfd);
+            close(connfd);
             LOG_WARN("Clients is full!");
-            return;
         } else {
             AddClient(connfd, addr);
         }
-    } while (m_listenEvent & EPOLLET);
+    }
+    /*达到上限时队列中可能还有连接，ET模式不会再次通知，由事件循环在处理完本轮事件后继续接受*/
+    m_acceptPending = (m_listenEvent & EPOLLET);
 }
 
 void Server::ProcessWrite(HttpConn *client) {
     assert(client);
     ResetTime(client);
-    m_threadPool->AddTask(std::bind(&Server::Write, this, client));
+    client->OnEnqueue(); //写响应仍属于已解析的那个请求，沿用其追踪id
+    Dispatch(client, std::bind(&Server::Write, this, client));
+}
+
+void Server::Dispatch(HttpConn *client, std::function<void()> task) {
+    client->SetInPool(true);
+    m_threadPool->AddTask(std::move(task));
 }
 
 void Server::ProcessRead(HttpConn *client) {
     assert(client);
+    if (m_inlineMaxBytes > 0) {
+        ServeInline(client);
+        return;
+    }
+    if (!m_admission->Admit(NowNs())) {
+        /*过载时不把请求交给线程池，在事件循环中直接回复503并关闭连接*/
+        SendBusy(client->GetFd());
+        CloseConn(client);
+        return;
+    }
     ResetTime(client);
-    m_threadPool->AddTask(std::bind(&Server::Read, this, client));
+    client->OnEnqueue();
+    Dispatch(client, std::bind(&Server::Read, this, client));
 }
 
-void Server::SendError(int fd, const char *info) {
+void Server::ServeInline(HttpConn *client) {
+    ResetTime(client);
+    client->OnEnqueue();
+    {
+        TraceContext trace(client->TraceId(), client->QueuedNs(), client->OnTaskStart());
+        int readErrno = 0;
+        ssize_t ret = client->Read(&readErrno); //非阻塞读，不会卡住事件循环
+        if (ret <= 0 && readErrno != EAGAIN) {
+            CloseConn(client);
+            return;
+        }
+        /*响应来自内存且足够小，解析和写都不会阻塞，省去投递线程池、线程切换和一次epoll_ctl；
+         *流水线中连续的请求一起处理，待发送字节数受高水位限制*/
+        int count;
+        while ((count = client->ProcessRequests(m_inlineMaxBytes)) > 0) {
+            Metrics::Add(Metrics::INLINE_REQUESTS, count);
+            int writeErrno = 0;
+            ret = client->Write(&writeErrno);
+            if (client->ToWriteBytes() > 0) {
+                if (ret > 0 || writeErrno == EAGAIN) {
+                    m_epoller->ModFd(client->GetFd(), m_connEvent | EPOLLOUT); //剩余部分由线程池写
+                } else {
+                    CloseConn(client);
+                }
+                return;
+            }
+            if (!client->IsKeepAlive()) {
+                CloseConn(client);
+                return;
+            }
+        }
+        if (!client->HasPendingRequest()) {
+            m_epoller->ModFd(client->GetFd(), m_connEvent | EPOLLIN);
+            return;
+        }
+    }
+    /*需要访问数据库、读磁盘或者请求还不完整，交给线程池*/
+    if (!m_admission->Admit(NowNs())) {
+        SendBusy(client->GetFd());
+        CloseConn(client);
+        return;
+    }
+    client->OnEnqueue();
+    Dispatch(client, std::bind(&Server::Process, this, client));
+}
+
+void Server::SendBusy(int fd) {
     assert(fd > 0);
-    int ret = send(fd, info, strlen(info), 0);
+    Metrics::Add(Metrics::SHED_REQUESTS);
+    /*先读走已到达的请求，否则关闭时接收缓冲区中有未读数据，内核会发RST，对端可能收不到503*/
+    char buf[4096];
+    for (int i = 0; i < 16 && recv(fd, buf, sizeof(buf), MSG_DONTWAIT) > 0; i++) {
+    }
+    ssize_t ret = send(fd, m_busyResponse.data(), m_busyResponse.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
     if (ret < 0) {
-        LOG_WARN("Send error to client[%d] error", fd);
+        LOG_WARN("Send busy to client[%d] error", fd);
     }
-    close(fd);
 }
 
 void Server::ResetTime(HttpConn *client) {
@@ -184,58 +422,101 @@ void Server::ResetTime(HttpConn *client) {
 
 void Server::AddClient(int fd, sockaddr_in addr) {
     assert(fd > 0);
+    Metrics::Add(Metrics::ACCEPTS);
     m_users[fd].Init(fd, addr); //用户初始化
     if (m_timeoutMs > 0) {
-        m_timer->Add(fd, m_timeoutMs, std::bind(&Server::CloseConn, this, &m_users[fd])); //注册定时器
+        m_timer->Add(fd, m_timeoutMs, std::bind(&Server::OnTimeout, this, &m_users[fd])); //注册定时器
     }
-    m_epoller->AddFd(fd, EPOLLIN | m_connEvent); //内核事件表注册用户事件
-    SetFdNonBlock(fd);                           //设置非阻塞模式
+    if (m_socket.noDelay) {
+        int optval = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+    }
+    m_epoller->AddFd(fd, EPOLLIN | m_connEvent); //内核事件表注册用户事件，fd已由accept4设置为非阻塞
     LOG_INFO("Client[%d] in!", m_users[fd].GetFd());
 }
 
 void Server::CloseConn(HttpConn *client) {
     assert(client);
     LOG_INFO("Client[%d] quit!", client->GetFd());
+    if (m_timeoutMs > 0) {
+        m_timer->Remove(client->GetFd()); //否则fd被新连接复用后会被旧的定时器关闭
+    }
     m_epoller->DelFd(client->GetFd());
     client->Close();
 }
 
+void Server::OnTimeout(HttpConn *client) {
+    assert(client);
+    if (client->InPool()) {
+        client->SetTimedOut();
+        return;
+    }
+    CloseConn(client);
+}
+
+void Server::DrainCompletions() {
+    CompletionQueue::Completion completion;
+    TimeStamp expires = Clock::now() + MS(m_timeoutMs); //本批次共用一次取时间
+    while (m_completions->Pop(completion)) {
+        Metrics::Add(Metrics::COMPLETIONS);
+        HttpConn *client = &m_users[completion.fd];
+        client->SetInPool(false);
+        if (completion.action == CompletionQueue::CLOSE || client->TimedOut()) {
+            CloseConn(client);
+            continue;
+        }
+        if (m_timeoutMs > 0) {
+            m_timer->AdjustTo(completion.fd, expires);
+        }
+        uint32_t event = completion.action == CompletionQueue::REARM_WRITE ? EPOLLOUT : EPOLLIN;
+        m_epoller->ModFd(completion.fd, m_connEvent | event);
+    }
+}
+
 void Server::Write(HttpConn *client) {
     assert(client);
     int ret = -1;
     int writeErrno = 0;
+    TraceContext trace(client->TraceId(), client->QueuedNs(), client->OnTaskStart());
     ret = client->Write(&writeErrno);
-    if (client->ToWriteBytes() == 0) {
-        if (client->IsKeepAlive()) {
-            KeepProcess(client);
-            return;
-        }
-    } else if (ret < 0) {
-        if (writeErrno == EAGAIN) {
-            m_epoller->ModFd(client->GetFd(), m_connEvent | EPOLLOUT);
-            return;
-        }
+    size_t left = client->ToWriteBytes();
+    if (left > 0 && ret < 0 && writeErrno != EAGAIN) {
+        m_completions->Post(client->GetFd(), CompletionQueue::CLOSE);
+        return;
     }
-    CloseConn(client);
+    if (left > HttpConn::lowWater || !client->IsKeepAlive()) {
+        /*发送缓冲区满或用完写预算，等待可写后继续；非keep-alive的连接写完后关闭*/
+        m_completions->Post(client->GetFd(), left > 0 ? CompletionQueue::REARM_WRITE : CompletionQueue::CLOSE);
+        return;
+    }
+    KeepProcess(client); //低于低水位，继续处理流水线中已经到达的请求
 }
 
 void Server::Read(HttpConn *client) {
     assert(client);
     int ret = -1;
     int readErrno = 0;
+    TraceContext trace(client->TraceId(), client->QueuedNs(), client->OnTaskStart());
     ret = client->Read(&readErrno);
     if (ret <= 0 && readErrno != EAGAIN) {
-        CloseConn(client);
+        m_completions->Post(client->GetFd(), CompletionQueue::CLOSE);
         return;
     }
     KeepProcess(client);
 }
 
+void Server::Process(HttpConn *client) {
+    assert(client);
+    TraceContext trace(client->TraceId(), client->QueuedNs(), client->OnTaskStart());
+    KeepProcess(client);
+}
+
 void Server::KeepProcess(HttpConn *client) {
-    if (client->Process()) {
-        m_epoller->ModFd(client->GetFd(), m_connEvent | EPOLLOUT); //监听输出
+    client->ProcessRequests(0);
+    if (client->ToWriteBytes() > 0) {
+        m_completions->Post(client->GetFd(), CompletionQueue::REARM_WRITE); //监听输出
     } else {
-        m_epoller->ModFd(client->GetFd(), m_connEvent | EPOLLIN); //监听接收
+        m_completions->Post(client->GetFd(), CompletionQueue::REARM_READ); //监听接收
     }
 }
 
@@ -243,18 +524,31 @@ void Server::Start() {
     int timeMS = -1; //超时值为-1会导致epoll_wait（）无限期阻塞
     if (!m_isClosed) {
         LOG_INFO("========== Server start ==========");
+        if (m_loopStallNs > 0) {
+            m_watchdog->Start(m_loopStallNs);
+        }
     }
     while (!m_isClosed) {
         if (m_timeoutMs > 0) {
             timeMS = m_timer->GetNextTick();
         }
+        if (m_acceptPending) {
+            timeMS = 0; //还有连接等待接受，只收集已就绪的事件，不阻塞
+        }
+        m_watchdog->LoopIdle();
         int eventCnt = m_epoller->Wait(timeMS);
+        m_watchdog->LoopBusy();
+        bool listened = false;
         for (int i = 0; i < eventCnt; i++) {
             int fd = m_epoller->GetEventFd(i);         //获取事件发生的文件描述符
             uint32_t events = m_epoller->GetEvents(i); //获取发生的事件
             if (fd == m_listenFd) {
                 /*新的连接请求到来*/
                 ProcessListen();
+                listened = true;
+            } else if (fd == m_completions->Fd()) {
+                /*工作线程投递了完成通知，在本轮最后统一处理*/
+                m_completions->OnWakeup();
             } else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
                 /*有异常事件发生*/
                 assert(m_users.count(fd) > 0);
@@ -271,5 +565,9 @@ void Server::Start() {
                 LOG_ERROR("Unexpected event");
             }
         }
+        if (m_acceptPending && !listened) {
+            ProcessListen();
+        }
+        DrainCompletions(); //没有被唤醒时也顺带取走已到达的通知
     }
 }
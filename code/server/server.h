@@ -2,12 +2,24 @@
 #define SERVER_H
 #include "../http/http_conn.h"
 #include "../log/log.h"
+#include "../metrics/metrics.h"
+#include "../metrics/profiler.h"
+#include "../metrics/tracer.h"
 #include "../pool/sql_conn_pool.h"
 #include "../pool/thread_pool.h"
+#include "../store/memory_user_store.h"
+#include "../store/mysql_user_store.h"
 #include "../timer/heap_timer.h"
+#include "admin_server.h"
+#include "admission.h"
+#include "completion_queue.h"
 #include "epoller.h"
+#include "server_config.h"
+#include "watchdog.h"
+#include "../http/warmup.h"
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <unistd.h>
@@ -26,8 +38,20 @@ private:
     uint32_t m_listenEvent;
     uint32_t m_connEvent;
     std::unique_ptr<HeapTimer> m_timer;
+    std::unique_ptr<CompletionQueue> m_completions; //工作线程到事件循环的完成通知，须在线程池之后析构
     std::unique_ptr<ThreadPool> m_threadPool;
     std::unique_ptr<Epoller> m_epoller;
+    std::unique_ptr<UserStore> m_userStore;
+    std::unique_ptr<AdminServer> m_admin;
+    std::unique_ptr<Watchdog> m_watchdog;
+    std::unique_ptr<AdmissionControl> m_admission;
+    std::string m_busyResponse; //预先生成的503响应
+    int64_t m_loopStallNs; //事件循环卡顿阈值，为0时不启动看门狗线程
+    SocketProfile m_socket;
+    int m_acceptBatch;    //每轮最多接受的连接数
+    bool m_acceptPending; //上一轮达到上限，监听队列中可能还有连接
+    int m_idleFd;         //预留的fd，fd耗尽时用来接受并关闭连接
+    size_t m_inlineMaxBytes; //在事件循环中直接处理的响应大小上限，为0时全部交给线程池
     std::unordered_map<int, HttpConn> m_users; //用户fd到HttpConn实例的映射
     static const int MAX_FD = 65536;
 
@@ -35,32 +59,45 @@ private:
     void InitEventMode(int trigMode);
     /*初始化监听socket*/
     bool InitSocket();
-    /*设置为非阻塞IO */
-    static int SetFdNonBlock(int fd);
+    /*按m_socket设置监听socket的可选TCP参数，失败时只记录警告*/
+    void ApplyListenOptions();
     /*处理新的用户请求*/
     void ProcessListen();
     /*将用户的写任务放入线程池的工作队列*/
     void ProcessWrite(HttpConn *client);
     /*将用户的读任务放入线程池的工作队列*/
     void ProcessRead(HttpConn *client);
-    /*发送错误提示*/
-    void SendError(int fd, const char *info);
+    /*在事件循环中读取请求，能由缓存生成响应的直接处理并写回，其余交给线程池*/
+    void ServeInline(HttpConn *client);
+    /*过载或连接数超限时在事件循环中直接发送503，不经过线程池，由调用者关闭连接*/
+    void SendBusy(int fd);
     /*重置某个用户的超时时间*/
     void ResetTime(HttpConn *client);
     /*添加新用户*/
     void AddClient(int fd, sockaddr_in addr);
-    /*关闭用户连接*/
+    /*关闭用户连接，只在事件循环中调用*/
     void CloseConn(HttpConn *client);
+    /*连接超时；正在线程池中处理的连接等收到完成通知后再关闭*/
+    void OnTimeout(HttpConn *client);
+    /*把任务交给线程池，之后直到收到完成通知，事件循环不再访问该连接*/
+    void Dispatch(HttpConn *client, std::function<void()> task);
+    /*取出全部完成通知，批量修改epoll监听事件和定时器*/
+    void DrainCompletions();
     /*用户写操作*/
     void Write(HttpConn *client);
     /*用户读操作*/
     void Read(HttpConn *client);
-    /**/
+    /*处理事件循环已读入的请求*/
+    void Process(HttpConn *client);
+    /*处理读缓冲区中的请求(受高水位限制)，投递监听可写或可读的完成通知*/
     void KeepProcess(HttpConn *client);
+    /*启动管理端口并注册指标*/
+    void InitAdmin(const ServerConfig &config);
 
 public:
     Server(int port, int trigMode, int timeoutMS, bool Linger, int sqlPort, const char *sqlUser, const char *sqlPwd,
-           const char *dbName, int connPoolNum, int threadNum, bool openLog, int logLevel, int logQueSize);
+           const char *dbName, int connPoolNum, int threadNum, bool openLog, int logLevel, int logQueSize,
+           const ServerConfig &config = ServerConfig());
     ~Server();
     void Start();
 };
@@ -0,0 +1,88 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*监听socket和已连接socket的TCP参数*/
+struct SocketProfile {
+    /*listen的backlog，实际值还受net.core.somaxconn限制*/
+    int backlog = 1024;
+    /*TCP_DEFER_ACCEPT：连接上有数据到达才唤醒accept(秒)，只建连不发请求的连接不会唤醒事件循环，为0时关闭*/
+    int deferAcceptSec = 1;
+    /*TCP_FASTOPEN的队列长度，为0时关闭；还需要net.ipv4.tcp_fastopen开启服务端支持*/
+    int fastOpenQueue = 0;
+    /*已连接socket关闭Nagle算法，小响应不等待对端ACK*/
+    bool noDelay = true;
+    /*较大的响应在写入期间设置TCP_CORK，写完后再推送最后不满一个MSS的数据*/
+    bool cork = true;
+    /*SO_SNDBUF、SO_RCVBUF(字节)，为0时使用内核默认值和自动调节；在监听socket上设置，已连接socket继承*/
+    int sndBuf = 0;
+    int rcvBuf = 0;
+};
+
+/*服务器的可选配置项，构造Server时未指定的项使用默认值*/
+struct ServerConfig {
+    /*用户名布隆过滤器：预计用户数(为0时不启用)与期望误判率*/
+    size_t userFilterCapacity = 10000000;
+    double userFilterFpRate = 0.01;
+    /*用户存储后端："mysql" 或进程内的 "memory"(压测时使用，无需mysqld)*/
+    std::string userStore = "mysql";
+    /*memory后端每次访问模拟的数据库延迟(微秒)*/
+    int userStoreLatencyUs = 0;
+    /*管理端口(/metrics等)，为0时不启用；默认只监听本机地址*/
+    int adminPort = 0;
+    std::string adminAddr = "127.0.0.1";
+    /*请求追踪：每N个请求采样一个，为0时关闭，可通过管理端口/trace?sample=N动态修改*/
+    uint32_t traceSampleEvery = 0;
+    /*慢请求日志：总耗时超过该值(毫秒)的请求以WARN级别记录各阶段耗时，为0时关闭*/
+    int slowRequestMs = 1000;
+    /*事件循环一轮处理超过该值(毫秒)时记录警告和调用栈，为0时关闭看门狗*/
+    int loopStallMs = 100;
+    /*锁统计的运行时开关，需要以make LOCK_STATS=1编译才有统计*/
+    bool lockStats = false;
+    SocketProfile socket;
+    /*过载保护：线程池排队时间持续超过目标值(毫秒)时，在事件循环中直接回复503，为0时关闭；
+     *判断是否持续超过的统计周期(毫秒)；队列长度上限，为0时不限制；503响应的Retry-After(秒)*/
+    int overloadTargetMs = 50;
+    int overloadIntervalMs = 100;
+    size_t overloadMaxQueue = 10000;
+    int retryAfterSec = 1;
+    /*小文件缓存：总字节数(为0时不缓存)，单个文件的大小上限*/
+    size_t fileCacheBytes = 64 * 1024 * 1024;
+    size_t fileCacheMaxFile = 64 * 1024;
+    /*响应完全由缓存生成且不超过该字节数(大致能一次写入socket发送缓冲区)的GET请求在事件循环中直接处理，为0时关闭*/
+    size_t inlineMaxBytes = 16 * 1024;
+    /*由tools/pack生成的资源包，为空时直接读resources目录；populate以MAP_POPULATE映射，
+     *hugePages时复制到匿名内存并使用透明大页*/
+    std::string packFile;
+    bool packPopulate = false;
+    bool packHugePages = false;
+    /*启动预热：预读进页缓存的字节数上限(为0时不预热)，其中mlock常驻内存的字节数上限；
+     *hitListFile为上次运行保存的命中列表，为空时只按文件大小预热，每hitListIntervalSec秒保存一次*/
+    size_t warmupBytes = 256 * 1024 * 1024;
+    size_t warmupLockBytes = 0;
+    std::string hitListFile;
+    int hitListIntervalSec = 60;
+    /*预先生成的响应头的缓存字节数，为0时每个请求重新生成*/
+    size_t headerCacheBytes = 1024 * 1024;
+    /*即时压缩：压缩结果缓存的总字节数(为0时只使用预压缩的.gz/.br文件)，即时压缩的原文件大小上限*/
+    size_t compressCacheBytes = 16 * 1024 * 1024;
+    size_t compressMaxFile = 1024 * 1024;
+    /*按文件后缀设置的Cache-Control，如{".css", "max-age=86400"}，后缀为"*"时作为默认值；为空时不发送*/
+    std::vector<std::pair<std::string, std::string>> cacheControl;
+    /*请求消息体的字节数上限；较大的消息体写入的临时文件所在目录*/
+    size_t maxBodyBytes = 64 * 1024 * 1024;
+    std::string bodyTmpDir = "/tmp";
+    /*每个连接待发送字节数的高、低水位和每次写的字节数上限，见HttpConn*/
+    size_t writeHighWater = 256 * 1024;
+    size_t writeLowWater = 64 * 1024;
+    size_t writeBudget = 1024 * 1024;
+    /*事件循环每轮最多接受的新连接数*/
+    int acceptBatch = 64;
+};
+
+#endif // !SERVER_CONFIG_H
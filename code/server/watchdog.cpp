@@ -0,0 +1,122 @@
+#include "watchdog.h"
+#include "../log/log.h"
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <execinfo.h>
+#include <signal.h>
+
+namespace {
+
+const int STACK_SIGNAL = SIGUSR2;
+const int MAX_FRAMES = 64;
+void *g_frames[MAX_FRAMES];
+std::atomic<int> g_frameCount(-1); //信号处理函数写入的栈帧数，-1表示尚未抓取
+
+void OnStackSignal(int) {
+    int savedErrno = errno;
+    g_frameCount.store(backtrace(g_frames, MAX_FRAMES), std::memory_order_release);
+    errno = savedErrno;
+}
+
+} // namespace
+
+Watchdog::Watchdog() : m_stallNs(0), m_lastReturnNs(0), m_busySince(0), m_loopThread(), m_isClosed(true) {}
+
+Watchdog::~Watchdog() {
+    Stop();
+}
+
+bool Watchdog::Start(int64_t stallNs) {
+    assert(stallNs > 0 && m_isClosed);
+    /*backtrace第一次调用时会加载libgcc，提前调用一次，避免在信号处理函数中分配内存*/
+    void *warmup[1];
+    backtrace(warmup, 1);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = OnStackSignal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(STACK_SIGNAL, &sa, nullptr) < 0) {
+        LOG_ERROR("Watchdog install signal handler error!");
+        return false;
+    }
+    m_stallNs = stallNs;
+    m_loopThread = pthread_self();
+    m_isClosed = false;
+    m_thread = std::thread(&Watchdog::Loop, this);
+    LOG_INFO("Watchdog started, stall threshold:%.1fms", stallNs / 1e6);
+    return true;
+}
+
+void Watchdog::Stop() {
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        if (m_isClosed) {
+            return;
+        }
+        m_isClosed = true;
+    }
+    m_cond.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void Watchdog::Loop() {
+    pthread_setname_np(pthread_self(), "watchdog");
+    /*检查周期取阈值的1/4，卡顿被发现时最多已超出阈值25%*/
+    const std::chrono::nanoseconds period(m_stallNs / 4 > 1000000 ? m_stallNs / 4 : 1000000);
+    int64_t reported = 0; //已报告过的那一轮的开始时间，同一轮只报告一次
+    std::unique_lock<std::mutex> locker(m_mutex);
+    while (!m_isClosed) {
+        m_cond.wait_for(locker, period);
+        if (m_isClosed) {
+            break;
+        }
+        int64_t since = m_busySince.load(std::memory_order_relaxed);
+        if (since == 0 || since == reported) {
+            continue;
+        }
+        int64_t lag = NowNs() - since;
+        if (lag < m_stallNs) {
+            continue;
+        }
+        reported = since;
+        Metrics::Add(Metrics::LOOP_STALLS);
+        locker.unlock(); //写日志可能较慢，不持有锁，以免阻塞Stop
+        LOG_WARN("Event loop stalled for %.1fms (threshold %.1fms)", lag / 1e6, m_stallNs / 1e6);
+        DumpLoopStack();
+        locker.lock();
+    }
+}
+
+void Watchdog::DumpLoopStack() {
+    g_frameCount.store(-1, std::memory_order_relaxed);
+    if (pthread_kill(m_loopThread, STACK_SIGNAL) != 0) {
+        LOG_WARN("Watchdog signal event loop error!");
+        return;
+    }
+    /*等待信号处理函数完成，事件循环若阻塞在不可中断的系统调用中可能需要一段时间*/
+    int n = -1;
+    for (int i = 0; i < 100; i++) {
+        n = g_frameCount.load(std::memory_order_acquire);
+        if (n >= 0) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (n < 0) {
+        LOG_WARN("Watchdog capture event loop stack timeout");
+        return;
+    }
+    char **symbols = backtrace_symbols(g_frames, n);
+    if (!symbols) {
+        return;
+    }
+    /*第0帧是信号处理函数本身*/
+    for (int i = 1; i < n; i++) {
+        LOG_WARN("  #%d %s", i - 1, symbols[i]);
+    }
+    free(symbols);
+}
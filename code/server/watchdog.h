@@ -0,0 +1,56 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include "../metrics/metrics.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+
+/*事件循环看门狗
+ *事件循环每轮在epoll_wait返回和再次进入时打点，记录本轮处理耗时和两次返回之间的间隔；
+ *监视线程定期检查循环是否在某一轮中停留超过阈值，若是则记录警告，
+ *并向事件循环线程发送信号，在信号处理函数中抓取其调用栈写入日志*/
+class Watchdog
+{
+public:
+    Watchdog();
+    ~Watchdog();
+    /*在事件循环线程中调用，stallNs为判定卡顿的阈值(纳秒)*/
+    bool Start(int64_t stallNs);
+    void Stop();
+
+    /*epoll_wait返回，开始处理本轮事件*/
+    void LoopBusy() {
+        int64_t now = NowNs();
+        if (m_lastReturnNs) {
+            Metrics::Record(Metrics::LOOP_INTERVAL, now - m_lastReturnNs);
+        }
+        m_lastReturnNs = now;
+        m_busySince.store(now, std::memory_order_relaxed);
+    }
+    /*本轮事件处理完毕，即将进入epoll_wait*/
+    void LoopIdle() {
+        if (m_lastReturnNs) {
+            Metrics::Record(Metrics::LOOP_BUSY, NowNs() - m_lastReturnNs);
+        }
+        m_busySince.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    int64_t m_stallNs;
+    int64_t m_lastReturnNs;           //只由事件循环线程读写
+    std::atomic<int64_t> m_busySince; //本轮开始处理的时间，为0表示正阻塞在epoll_wait中
+    pthread_t m_loopThread;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_isClosed;
+
+    void Loop();
+    /*抓取事件循环线程的调用栈并写入日志*/
+    void DumpLoopStack();
+};
+
+#endif // !WATCHDOG_H
@@ -0,0 +1,25 @@
+#include "memory_user_store.h"
+#include <chrono>
+#include <thread>
+
+MemoryUserStore::MemoryUserStore(int latencyUs) : m_latencyUs(latencyUs) {
+}
+
+void MemoryUserStore::SimulateLatency() const {
+    if (m_latencyUs > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(m_latencyUs));
+    }
+}
+
+bool MemoryUserStore::Login(const std::string &name, const std::string &pwd) {
+    SimulateLatency();
+    std::lock_guard<std::mutex> locker(m_mutex);
+    auto it = m_users.find(name);
+    return it != m_users.end() && it->second == pwd;
+}
+
+bool MemoryUserStore::Register(const std::string &name, const std::string &pwd) {
+    SimulateLatency();
+    std::lock_guard<std::mutex> locker(m_mutex);
+    return m_users.emplace(name, pwd).second;
+}
@@ -0,0 +1,30 @@
+#ifndef MEMORY_USER_STORE_H
+#define MEMORY_USER_STORE_H
+
+#include "user_store.h"
+#include <mutex>
+#include <unordered_map>
+
+/*进程内的用户存储，用于没有mysqld的压测环境
+ *latencyUs模拟每次访问数据库的耗时，访问期间占用调用线程，与真实数据库的阻塞行为一致*/
+class MemoryUserStore : public UserStore
+{
+private:
+    int m_latencyUs;
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::string> m_users; //用户名到密码的映射
+
+    void SimulateLatency() const;
+
+public:
+    explicit MemoryUserStore(int latencyUs = 0);
+    ~MemoryUserStore() override = default;
+
+    bool Login(const std::string &name, const std::string &pwd) override;
+    bool Register(const std::string &name, const std::string &pwd) override;
+    const char *Name() const override {
+        return "memory";
+    }
+};
+
+#endif // !MEMORY_USER_STORE_H
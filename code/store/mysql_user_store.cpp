@@ -0,0 +1,127 @@
+#include "mysql_user_store.h"
+#include <chrono>
+
+MysqlUserStore::MysqlUserStore() : m_userFilterLoadMs(0) {
+}
+
+bool MysqlUserStore::InitUserFilter(size_t capacity, double fpRate) {
+    if (capacity == 0) {
+        m_userFilter.reset();
+        return true;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::unique_ptr<BloomFilter> filter(new BloomFilter(capacity, fpRate));
+    MYSQL *sql;
+    SqlConnRAII raii(&sql, SqlConnPool::Instance());
+    if (!sql) {
+        LOG_ERROR("UserFilter load error: no sql connection!");
+        return false;
+    }
+    /*用户表可能有千万级记录，使用mysql_use_result逐行读取，不在客户端缓存整个结果集*/
+    if (mysql_query(sql, "SELECT username FROM user")) {
+        LOG_ERROR("UserFilter load error!");
+        return false;
+    }
+    MYSQL_RES *res = mysql_use_result(sql);
+    if (!res) {
+        LOG_ERROR("UserFilter load error!");
+        return false;
+    }
+    size_t count = 0;
+    while (MYSQL_ROW row = mysql_fetch_row(res)) {
+        unsigned long *lengths = mysql_fetch_lengths(res);
+        filter->Add(row[0], lengths[0]);
+        count++;
+    }
+    mysql_free_result(res);
+    m_userFilterLoadMs =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    m_userFilter = std::move(filter);
+    LOG_INFO("UserFilter loaded %zu users in %lld ms, bits:%zu, hashes:%d, memory:%zu KB", count, m_userFilterLoadMs,
+             m_userFilter->BitCount(), m_userFilter->HashCount(), m_userFilter->MemoryBytes() / 1024);
+    return true;
+}
+
+size_t MysqlUserStore::UserFilterBytes() const {
+    return m_userFilter ? m_userFilter->MemoryBytes() : 0;
+}
+
+long long MysqlUserStore::UserFilterLoadMs() const {
+    return m_userFilterLoadMs;
+}
+
+bool MysqlUserStore::Login(const std::string &name, const std::string &pwd) {
+    MYSQL *sql;
+    SqlConnRAII raii(&sql, SqlConnPool::Instance()); //离开作用域时自动将连接放回连接池
+    if (!sql) {
+        LOG_ERROR("SqlConnPool no connection!");
+        return false;
+    }
+    bool flag = false;
+    char order[256] = {0};
+    /* 查询用户及密码 */
+    /*用户账号是唯一标识的,如果明知道查询结果只有⼀个,SQL语句中使⽤LIMIT 1会提⾼查询效率*/
+    snprintf(order, 256, "SELECT username, password FROM user WHERE username='%s' LIMIT 1", name.c_str());
+    LOG_DEBUG("%s", order);
+    /*返回0表示查询成功，否则失败*/
+    if (mysql_query(sql, order)) {
+        return false;
+    }
+    /*对于成功检索了数据的每个查询，必须调用mysql_store_result()或mysql_use_result()*/
+    MYSQL_RES *res = mysql_store_result(sql);
+    /*处理执行结果一般放在while循环中，遍历每一行*/
+    while (MYSQL_ROW row = mysql_fetch_row(res)) { //返回执行结果的当前行的数值数组，执行这个函数后，结果指向下一行
+        LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
+        std::string passWord(row[1]);
+        if (pwd == passWord) {
+            flag = true;
+            LOG_DEBUG("pwd correct!");
+        } else {
+            flag = false;
+            LOG_DEBUG("pwd error!");
+        }
+    }
+    /*一旦完成了对结果集的操作，必须调用mysql_free_result()释放结果集，以防内存泄露*/
+    mysql_free_result(res);
+    return flag;
+}
+
+bool MysqlUserStore::Register(const std::string &name, const std::string &pwd) {
+    MYSQL *sql;
+    SqlConnRAII raii(&sql, SqlConnPool::Instance());
+    if (!sql) {
+        LOG_ERROR("SqlConnPool no connection!");
+        return false;
+    }
+    char order[256] = {0};
+    /*布隆过滤器判定用户名一定不存在，跳过查询直接插入*/
+    if (m_userFilter && !m_userFilter->MayContain(name)) {
+        LOG_DEBUG("user filter miss, skip query!");
+    } else {
+        snprintf(order, 256, "SELECT username FROM user WHERE username='%s' LIMIT 1", name.c_str());
+        LOG_DEBUG("%s", order);
+        if (mysql_query(sql, order)) {
+            return false;
+        }
+        MYSQL_RES *res = mysql_store_result(sql);
+        bool used = mysql_fetch_row(res) != nullptr;
+        mysql_free_result(res);
+        if (used) {
+            LOG_DEBUG("user used!");
+            return false;
+        }
+    }
+    /* 用户名未被使用*/
+    LOG_DEBUG("regirster!");
+    snprintf(order, 256, "INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(), pwd.c_str());
+    LOG_DEBUG("%s", order);
+    if (mysql_query(sql, order)) {
+        LOG_DEBUG("regirster error!");
+        return false;
+    }
+    LOG_DEBUG("regirster success!");
+    if (m_userFilter) {
+        m_userFilter->Add(name);
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef MYSQL_USER_STORE_H
+#define MYSQL_USER_STORE_H
+
+#include "../log/log.h"
+#include "../pool/sql_conn_pool.h"
+#include "../utils/bloom_filter.h"
+#include "user_store.h"
+#include <memory>
+#include <mysql/mysql.h>
+
+/*基于MySQL连接池的用户存储*/
+class MysqlUserStore : public UserStore
+{
+private:
+    std::unique_ptr<BloomFilter> m_userFilter; //已注册用户名的布隆过滤器
+    long long m_userFilterLoadMs;
+
+public:
+    MysqlUserStore();
+    ~MysqlUserStore() override = default;
+    /*从user表加载已有用户名到布隆过滤器，注册时可跳过对不存在用户名的查询*/
+    bool InitUserFilter(size_t capacity, double fpRate);
+    /*布隆过滤器占用的内存(字节)，未启用时为0*/
+    size_t UserFilterBytes() const;
+    /*布隆过滤器加载耗时(毫秒)*/
+    long long UserFilterLoadMs() const;
+
+    bool Login(const std::string &name, const std::string &pwd) override;
+    bool Register(const std::string &name, const std::string &pwd) override;
+    const char *Name() const override {
+        return "mysql";
+    }
+};
+
+#endif // !MYSQL_USER_STORE_H
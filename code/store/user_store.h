@@ -0,0 +1,19 @@
+#ifndef USER_STORE_H
+#define USER_STORE_H
+
+#include <string>
+
+/*用户存储接口，HttpRequest通过它完成登录校验和注册，不再直接依赖数据库*/
+class UserStore
+{
+public:
+    virtual ~UserStore() = default;
+    /*用户名存在且密码正确返回true*/
+    virtual bool Login(const std::string &name, const std::string &pwd) = 0;
+    /*用户名未被使用且写入成功返回true*/
+    virtual bool Register(const std::string &name, const std::string &pwd) = 0;
+    /*存储后端名称，用于日志*/
+    virtual const char *Name() const = 0;
+};
+
+#endif // !USER_STORE_H
@@ -1,16 +1,17 @@
 #include "heap_timer.h"
+#include "../metrics/metrics.h"
 #include <cassert>
 
 void HeapTimer::Siftup(size_t i) {
     assert(i >= 0 && i < m_heap.size());
-    size_t j = (i - 1) / 2; //父节点
-    while (j >= 0) {
+    /*size_t恒大于等于0，必须以i到达根节点作为终止条件*/
+    while (i > 0) {
+        size_t j = (i - 1) / 2; //父节点
         if (m_heap[j] < m_heap[i]) {
             break;
         }
         SwapNode(i, j);
         i = j;
-        j = (i - 1) / 2;
     }
 }
 
@@ -35,8 +36,8 @@ void HeapTimer::SwapNode(size_t i, size_t j) {
     assert(i >= 0 && i < m_heap.size());
     assert(j >= 0 && j < m_heap.size());
     std::swap(m_heap[i], m_heap[j]);
-    m_ref[m_heap[i].id] = j;
-    m_ref[m_heap[j].id] = i;
+    m_ref[m_heap[i].id] = i;
+    m_ref[m_heap[j].id] = j;
 }
 
 void HeapTimer::Del(size_t i) {
@@ -56,9 +57,23 @@ void HeapTimer::Del(size_t i) {
 }
 
 void HeapTimer::Adjust(int id, int timeout) {
+    AdjustTo(id, Clock::now() + MS(timeout));
+}
+
+void HeapTimer::AdjustTo(int id, TimeStamp expires) {
     assert(!m_heap.empty() && m_ref.count(id) > 0);
-    m_heap[m_ref[id]].expires = Clock::now() + MS(timeout);
-    Siftdown(m_ref[id], m_heap.size());
+    size_t i = m_ref[id];
+    m_heap[i].expires = expires;
+    if (!Siftdown(i, m_heap.size())) {
+        Siftup(i);
+    }
+}
+
+void HeapTimer::Remove(int id) {
+    auto it = m_ref.find(id);
+    if (it != m_ref.end()) {
+        Del(it->second);
+    }
 }
 
 void HeapTimer::Add(int id, int timeout, const TimeoutCallBack &cb) {
@@ -94,8 +109,8 @@ void HeapTimer::DoWork(int id) {
     }
     size_t i = m_ref[id];
     TimerNode node = m_heap[i];
+    Del(i); //先删除再回调，回调函数可能会修改堆
     node.cb();
-    Del(i);
 }
 
 void HeapTimer::Tick() {
@@ -110,8 +125,9 @@ void HeapTimer::Tick() {
         if (std::chrono::duration_cast<MS>(node.expires - Clock::now()).count() > 0) {
             break;
         }
+        Metrics::Add(Metrics::TIMER_EXPIRED);
+        Pop(); //先删除再回调，回调函数可能会修改堆
         node.cb();
-        Pop();
     }
 }
 
@@ -42,10 +42,14 @@ public:
     }
     /*调整指定id的定时器*/
     void Adjust(int id, int timeout);
+    /*将指定id的定时器设置为在expires过期，批量调整时由调用者只取一次当前时间*/
+    void AdjustTo(int id, TimeStamp expires);
+    /*删除指定id的定时器，不触发回调函数；不存在时什么也不做*/
+    void Remove(int id);
     /*添加定时器节点*/
     void Add(int id, int timeout, const TimeoutCallBack &cb);
     void Clear();
-    /* 删除指定id结点，并触发回调函数 */
+    /* 删除指定id结点，并触发回调函数；回调函数中可以增删定时器 */
     void DoWork(int id);
     /* 清除超时结点，并触发回调函数*/
     void Tick();
@@ -0,0 +1,107 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/*布隆过滤器：MayContain返回false表示一定不存在，返回true表示可能存在
+ *位数组由原子变量组成，Add与MayContain可在多个线程中并发调用*/
+class BloomFilter
+{
+private:
+    size_t m_bitCount;  //位数组长度
+    size_t m_wordCount; // 64位字的个数
+    int m_hashCount;    //哈希函数个数
+    std::unique_ptr<std::atomic<uint64_t>[]> m_bits;
+
+    /* FNV-1a 再经过 splitmix64 的收尾混合，使高低位都分布均匀 */
+    static uint64_t Hash(const char *key, size_t len) {
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < len; i++) {
+            h ^= static_cast<unsigned char>(key[i]);
+            h *= 1099511628211ULL;
+        }
+        return Mix(h);
+    }
+
+    static uint64_t Mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return x;
+    }
+
+public:
+    /*capacity为预计元素个数，fpRate为期望的误判率
+     *位数 m = -n*ln(p)/(ln2)^2，哈希函数个数 k = m/n*ln2*/
+    BloomFilter(size_t capacity, double fpRate) {
+        assert(capacity > 0 && fpRate > 0 && fpRate < 1);
+        const double ln2 = std::log(2.0);
+        double bits = -static_cast<double>(capacity) * std::log(fpRate) / (ln2 * ln2);
+        m_wordCount = static_cast<size_t>(std::ceil(bits / 64));
+        if (m_wordCount == 0) {
+            m_wordCount = 1;
+        }
+        m_bitCount = m_wordCount * 64;
+        m_hashCount = static_cast<int>(std::round(static_cast<double>(m_bitCount) / capacity * ln2));
+        if (m_hashCount < 1) {
+            m_hashCount = 1;
+        }
+        m_bits.reset(new std::atomic<uint64_t>[m_wordCount]);
+        for (size_t i = 0; i < m_wordCount; i++) {
+            m_bits[i].store(0, std::memory_order_relaxed);
+        }
+    }
+    ~BloomFilter() = default;
+
+    /*双重哈希 g_i(x) = h1(x) + i*h2(x) 模拟k个哈希函数*/
+    void Add(const char *key, size_t len) {
+        uint64_t h1 = Hash(key, len);
+        uint64_t h2 = Mix(h1 ^ 0x9e3779b97f4a7c15ULL) | 1;
+        for (int i = 0; i < m_hashCount; i++) {
+            size_t bit = (h1 + i * h2) % m_bitCount;
+            m_bits[bit / 64].fetch_or(1ULL << (bit % 64), std::memory_order_relaxed);
+        }
+    }
+
+    void Add(const std::string &key) {
+        Add(key.data(), key.size());
+    }
+
+    bool MayContain(const char *key, size_t len) const {
+        uint64_t h1 = Hash(key, len);
+        uint64_t h2 = Mix(h1 ^ 0x9e3779b97f4a7c15ULL) | 1;
+        for (int i = 0; i < m_hashCount; i++) {
+            size_t bit = (h1 + i * h2) % m_bitCount;
+            if (!(m_bits[bit / 64].load(std::memory_order_relaxed) & (1ULL << (bit % 64)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool MayContain(const std::string &key) const {
+        return MayContain(key.data(), key.size());
+    }
+
+    size_t MemoryBytes() const {
+        return m_wordCount * sizeof(uint64_t);
+    }
+
+    size_t BitCount() const {
+        return m_bitCount;
+    }
+
+    int HashCount() const {
+        return m_hashCount;
+    }
+};
+
+#endif // !BLOOM_FILTER_H
@@ -0,0 +1,14 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <cstdint>
+#include <time.h>
+
+/*单调时钟的纳秒时间戳，clock_gettime走vDSO，不陷入内核，适合在请求路径上频繁调用*/
+inline int64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+#endif // !CLOCK_H
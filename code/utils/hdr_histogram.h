@@ -0,0 +1,205 @@
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+/*HdrHistogram：对数分桶+桶内线性子桶，在[lowest, highest]范围内保持significantFigures位有效数字的精度
+ *Record只做原子加法，可在多个线程中并发调用且不会阻塞；读取端可随时合并、计算百分位*/
+class HdrHistogram
+{
+private:
+    int64_t m_lowest;
+    int64_t m_highest;
+    int m_unitMagnitude;                //最小可区分值的以2为底的对数
+    int m_subBucketHalfCountMagnitude;  //子桶数一半的以2为底的对数
+    int64_t m_subBucketCount;           //每个桶内的子桶数
+    int64_t m_subBucketHalfCount;
+    int64_t m_subBucketMask;
+    int m_bucketCount;
+    size_t m_countsLen;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_counts;
+    std::atomic<uint64_t> m_totalCount;
+    std::atomic<uint64_t> m_sum; //所有记录值之和，用于计算均值
+
+    int BucketIndex(int64_t value) const {
+        int pow2Ceiling = 64 - __builtin_clzll(static_cast<uint64_t>(value | m_subBucketMask));
+        return pow2Ceiling - m_unitMagnitude - (m_subBucketHalfCountMagnitude + 1);
+    }
+
+    int64_t SubBucketIndex(int64_t value, int bucketIndex) const {
+        return value >> (bucketIndex + m_unitMagnitude);
+    }
+
+    size_t CountsIndex(int64_t value) const {
+        int bucketIndex = BucketIndex(value);
+        int64_t subBucketIndex = SubBucketIndex(value, bucketIndex);
+        int64_t bucketBaseIndex = static_cast<int64_t>(bucketIndex + 1) << m_subBucketHalfCountMagnitude;
+        return static_cast<size_t>(bucketBaseIndex + subBucketIndex - m_subBucketHalfCount);
+    }
+
+    /*下标对应区间的最小值*/
+    int64_t ValueFromIndex(size_t index) const {
+        int bucketIndex = static_cast<int>(index >> m_subBucketHalfCountMagnitude) - 1;
+        int64_t subBucketIndex = (index & (m_subBucketHalfCount - 1)) + m_subBucketHalfCount;
+        if (bucketIndex < 0) {
+            subBucketIndex -= m_subBucketHalfCount;
+            bucketIndex = 0;
+        }
+        return subBucketIndex << (bucketIndex + m_unitMagnitude);
+    }
+
+    /*下标对应区间的最大值*/
+    int64_t HighestEquivalentValue(size_t index) const {
+        int64_t value = ValueFromIndex(index);
+        int bucketIndex = BucketIndex(value);
+        int64_t subBucketIndex = SubBucketIndex(value, bucketIndex);
+        int adjustedBucket = (subBucketIndex >= m_subBucketCount) ? bucketIndex + 1 : bucketIndex;
+        return value + (int64_t(1) << (m_unitMagnitude + adjustedBucket)) - 1;
+    }
+
+public:
+    HdrHistogram(int64_t lowest, int64_t highest, int significantFigures)
+        : m_lowest(lowest), m_highest(highest), m_totalCount(0), m_sum(0) {
+        assert(lowest >= 1 && highest >= 2 * lowest && significantFigures >= 1 && significantFigures <= 5);
+        int64_t largestSingleUnitResolution = 2 * static_cast<int64_t>(std::pow(10, significantFigures));
+        int subBucketCountMagnitude = static_cast<int>(std::ceil(std::log2(largestSingleUnitResolution)));
+        m_subBucketHalfCountMagnitude = (subBucketCountMagnitude > 1 ? subBucketCountMagnitude : 1) - 1;
+        m_unitMagnitude = static_cast<int>(std::floor(std::log2(lowest)));
+        m_subBucketCount = int64_t(1) << (m_subBucketHalfCountMagnitude + 1);
+        m_subBucketHalfCount = m_subBucketCount / 2;
+        m_subBucketMask = (m_subBucketCount - 1) << m_unitMagnitude;
+        /*计算覆盖highest需要的桶数*/
+        int64_t smallestUntrackable = m_subBucketCount << m_unitMagnitude;
+        m_bucketCount = 1;
+        while (smallestUntrackable <= highest) {
+            if (smallestUntrackable > INT64_MAX / 2) {
+                m_bucketCount++;
+                break;
+            }
+            smallestUntrackable <<= 1;
+            m_bucketCount++;
+        }
+        m_countsLen = static_cast<size_t>((m_bucketCount + 1) * m_subBucketHalfCount);
+        m_counts.reset(new std::atomic<uint64_t>[m_countsLen]);
+        Reset();
+    }
+    ~HdrHistogram() = default;
+    HdrHistogram(const HdrHistogram &) = delete;
+    HdrHistogram &operator=(const HdrHistogram &) = delete;
+
+    /*记录一个值，超出范围的值被截断到[0, highest]*/
+    void Record(int64_t value) {
+        if (value < 0) {
+            value = 0;
+        } else if (value > m_highest) {
+            value = m_highest;
+        }
+        m_counts[CountsIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        m_totalCount.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(static_cast<uint64_t>(value), std::memory_order_relaxed);
+    }
+
+    /*将另一个参数相同的直方图累加进来*/
+    void Merge(const HdrHistogram &other) {
+        assert(other.m_countsLen == m_countsLen && other.m_unitMagnitude == m_unitMagnitude);
+        for (size_t i = 0; i < m_countsLen; i++) {
+            uint64_t c = other.m_counts[i].load(std::memory_order_relaxed);
+            if (c) {
+                m_counts[i].fetch_add(c, std::memory_order_relaxed);
+            }
+        }
+        m_totalCount.fetch_add(other.TotalCount(), std::memory_order_relaxed);
+        m_sum.fetch_add(other.Sum(), std::memory_order_relaxed);
+    }
+
+    void Reset() {
+        for (size_t i = 0; i < m_countsLen; i++) {
+            m_counts[i].store(0, std::memory_order_relaxed);
+        }
+        m_totalCount.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t TotalCount() const {
+        return m_totalCount.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Sum() const {
+        return m_sum.load(std::memory_order_relaxed);
+    }
+
+    double Mean() const {
+        uint64_t total = TotalCount();
+        return total ? static_cast<double>(Sum()) / total : 0.0;
+    }
+
+    int64_t Min() const {
+        for (size_t i = 0; i < m_countsLen; i++) {
+            if (m_counts[i].load(std::memory_order_relaxed)) {
+                return ValueFromIndex(i);
+            }
+        }
+        return 0;
+    }
+
+    int64_t Max() const {
+        for (size_t i = m_countsLen; i > 0; i--) {
+            if (m_counts[i - 1].load(std::memory_order_relaxed)) {
+                return HighestEquivalentValue(i - 1);
+            }
+        }
+        return 0;
+    }
+
+    /*percentile取值(0, 100]，返回不小于该百分位的最小记录值(在精度范围内)*/
+    int64_t ValueAtPercentile(double percentile) const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < m_countsLen; i++) {
+            total += m_counts[i].load(std::memory_order_relaxed);
+        }
+        if (total == 0) {
+            return 0;
+        }
+        if (percentile > 100.0) {
+            percentile = 100.0;
+        }
+        uint64_t countAtPercentile = static_cast<uint64_t>(percentile / 100.0 * total + 0.5);
+        if (countAtPercentile < 1) {
+            countAtPercentile = 1;
+        }
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < m_countsLen; i++) {
+            cumulative += m_counts[i].load(std::memory_order_relaxed);
+            if (cumulative >= countAtPercentile) {
+                return HighestEquivalentValue(i);
+            }
+        }
+        return 0;
+    }
+
+    /*不大于value的记录数，用于导出累积分桶*/
+    uint64_t CountAtOrBelow(int64_t value) const {
+        if (value < 0) {
+            return 0;
+        }
+        if (value > m_highest) {
+            value = m_highest;
+        }
+        size_t last = CountsIndex(value);
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i <= last; i++) {
+            cumulative += m_counts[i].load(std::memory_order_relaxed);
+        }
+        return cumulative;
+    }
+
+    size_t MemoryBytes() const {
+        return m_countsLen * sizeof(uint64_t);
+    }
+};
+
+#endif // !HDR_HISTOGRAM_H
@@ -0,0 +1,80 @@
+#ifndef MPSC_RING_H
+#define MPSC_RING_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*有界的多生产者单消费者无锁环形队列(Vyukov的有界队列)
+ *每个槽位带一个序号：序号等于写位置时可写，等于写位置+1时可读；
+ *生产者以CAS争抢写位置，消费者只有一个，读位置不需要原子操作*/
+template <typename T>
+class MpscRing
+{
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask;
+    /*写位置被生产者频繁修改，与读位置隔开一个缓存行，避免伪共享；
+     *不用alignas，C++14的new不保证超过16字节的对齐*/
+    std::atomic<size_t> m_tail; //下一个写位置
+    char m_pad[64];
+    size_t m_head; //下一个读位置，只由消费者访问
+
+public:
+    /*容量向上取整为2的幂*/
+    explicit MpscRing(size_t capacity) : m_tail(0), m_head(0) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_cells.reset(new Cell[size]);
+        m_mask = size - 1;
+        for (size_t i = 0; i < size; i++) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /*队列已满时返回false*/
+    bool Push(const T &value) {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; //槽位还没有被消费者取走
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed); //被其他生产者抢先
+            }
+        }
+        cell->data = value;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*只能在消费者线程中调用，队列为空时返回false*/
+    bool Pop(T &value) {
+        Cell &cell = m_cells[m_head & m_mask];
+        size_t seq = cell.seq.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(m_head + 1) < 0) {
+            return false;
+        }
+        value = cell.data;
+        cell.seq.store(m_head + m_mask + 1, std::memory_order_release);
+        m_head++;
+        return true;
+    }
+};
+
+#endif // !MPSC_RING_H
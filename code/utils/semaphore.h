@@ -1,17 +1,20 @@
 #ifndef SEMAPHORE_H
 #define SEMAPHORE_H
 
+#include "../metrics/lock_stats.h"
 #include <condition_variable>
 #include <mutex>
 class Semaphore
 {
 private:
     int m_count;
-    std::mutex m_mutex;
-    std::condition_variable m_cond;
+    ServerMutex m_mutex;
+    ServerCondVar m_cond;
 
 public:
-    Semaphore(){};
+    Semaphore() {
+        NameLock(m_mutex, "semaphore");
+    };
     ~Semaphore(){};
 
     void InitSem(int count) {
@@ -19,7 +22,7 @@ public:
     }
 
     void Acquire() {
-        std::unique_lock<std::mutex> locker(m_mutex);
+        std::unique_lock<ServerMutex> locker(m_mutex);
         while (m_count == 0) {
             m_cond.wait(locker);
         }
@@ -27,7 +30,7 @@ public:
     }
 
     void Release() {
-        std::lock_guard<std::mutex> locker(m_mutex);
+        std::lock_guard<ServerMutex> locker(m_mutex);
         m_count++;
         m_cond.notify_one();
     }
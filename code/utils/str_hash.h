@@ -0,0 +1,29 @@
+#ifndef STR_HASH_H
+#define STR_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*编译期字符串哈希(FNV-1a，32位)
+ *把StrHash("字面量")用作switch的case标签即构成静态的完美哈希表：哈希值重复时编译报错，
+ *命中后再用StrEquals确认，查找不分配内存，也没有运行时初始化*/
+constexpr uint32_t StrHash(const char *str, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ static_cast<uint8_t>(str[i])) * 16777619u;
+    }
+    return hash;
+}
+
+template <size_t N>
+constexpr uint32_t StrHash(const char (&literal)[N]) {
+    return StrHash(literal, N - 1);
+}
+
+template <size_t N>
+inline bool StrEquals(const char *str, size_t len, const char (&literal)[N]) {
+    return len == N - 1 && memcmp(str, literal, len) == 0;
+}
+
+#endif // !STR_HASH_H
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""汇总run_bench.sh各负载的loadgen结果，并与基线比对。
+
+吞吐下降或p99延迟上升超过阈值即视为回退，以状态码1退出。
+"""
+import argparse
+import json
+import os
+import platform
+import sys
+import time
+
+
+def load_results(results_dir, out_name):
+    workloads = {}
+    for name in sorted(os.listdir(results_dir)):
+        if not name.endswith(".json") or name == out_name:
+            continue
+        with open(os.path.join(results_dir, name)) as f:
+            workloads[name[:-len(".json")]] = json.load(f)
+    return workloads
+
+
+def compare(current, baseline, threshold):
+    """返回(表格行, 回退列表)"""
+    rows = []
+    regressions = []
+    limit = threshold / 100.0
+    for name, cur in current.items():
+        base = baseline.get(name)
+        rps = cur["requests_per_sec"]
+        p99 = cur["latency_us"]["p99"]
+        if cur.get("errors", 0) or cur.get("timeouts", 0):
+            regressions.append("%s: %d errors, %d timeouts" % (name, cur.get("errors", 0), cur.get("timeouts", 0)))
+        if base is None:
+            rows.append((name, rps, None, p99, None))
+            continue
+        base_rps = base["requests_per_sec"]
+        base_p99 = base["latency_us"]["p99"]
+        rps_delta = (rps - base_rps) / base_rps if base_rps else 0.0
+        p99_delta = (p99 - base_p99) / base_p99 if base_p99 else 0.0
+        rows.append((name, rps, rps_delta, p99, p99_delta))
+        if rps_delta < -limit:
+            regressions.append("%s: throughput %.1f -> %.1f req/s (%+.1f%%)" % (name, base_rps, rps, rps_delta * 100))
+        if p99_delta > limit:
+            regressions.append("%s: p99 %d -> %d us (%+.1f%%)" % (name, base_p99, p99, p99_delta * 100))
+    return rows, regressions
+
+
+def fmt_delta(delta):
+    return "" if delta is None else "(%+.1f%%)" % (delta * 100)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--results", required=True, help="directory of loadgen JSON files")
+    parser.add_argument("--out", required=True, help="merged results file")
+    parser.add_argument("--baseline", help="baseline results file")
+    parser.add_argument("--threshold", type=float, default=10.0, help="allowed regression in percent")
+    args = parser.parse_args()
+
+    workloads = load_results(args.results, os.path.basename(args.out))
+    merged = {
+        "date": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+        "host": {"cpus": os.cpu_count(), "kernel": platform.release(), "machine": platform.machine()},
+        "workloads": workloads,
+    }
+    with open(args.out, "w") as f:
+        json.dump(merged, f, indent=2)
+        f.write("\n")
+
+    baseline = {}
+    if args.baseline and os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = json.load(f).get("workloads", {})
+    rows, regressions = compare(workloads, baseline, args.threshold)
+
+    print("%-18s %14s %10s %12s %10s" % ("workload", "req/s", "", "p99(us)", ""))
+    for name, rps, rps_delta, p99, p99_delta in rows:
+        print("%-18s %14.1f %10s %12d %10s" % (name, rps, fmt_delta(rps_delta), p99, fmt_delta(p99_delta)))
+    print("results: %s" % args.out)
+    if not baseline:
+        print("no baseline at %s, run 'make bench-baseline' to record one" % args.baseline)
+    if regressions:
+        print("REGRESSIONS (threshold %.1f%%):" % args.threshold)
+        for item in regressions:
+            print("  " + item)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,241 @@
+/*
+ * 核心组件的微基准测试：Buffer、HttpRequest::Parse、HttpResponse::Respond、HeapTimer、ThreadPool、Log
+ * 使用Google Benchmark，结果可用--benchmark_format=json或--benchmark_out输出为JSON，便于比对回归
+ */
+#include "../../code/buffer/buffer.h"
+#include "../../code/http/parse_http.h"
+#include "../../code/http/respond_http.h"
+#include "../../code/log/log.h"
+#include "../../code/pool/thread_pool.h"
+#include "../../code/store/memory_user_store.h"
+#include "../../code/timer/heap_timer.h"
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/*请求语料：简单GET、带完整浏览器头部的GET、登录表单POST*/
+const char *REQ_SIMPLE = "GET / HTTP/1.1\r\nHost: 127.0.0.1:1316\r\nConnection: keep-alive\r\n\r\n";
+
+const char *REQ_BROWSER =
+    "GET /picture.html HTTP/1.1\r\n"
+    "Host: 192.168.1.10:1316\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 "
+    "Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+    "Referer: http://192.168.1.10:1316/index.html\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark\r\n"
+    "\r\n";
+
+const char *REQ_LOGIN = "POST /login HTTP/1.1\r\n"
+                        "Host: 192.168.1.10:1316\r\n"
+                        "Connection: keep-alive\r\n"
+                        "Content-Length: 34\r\n"
+                        "Content-Type: application/x-www-form-urlencoded\r\n"
+                        "Origin: http://192.168.1.10:1316\r\n"
+                        "Referer: http://192.168.1.10:1316/login.html\r\n"
+                        "\r\n"
+                        "userName=bench&passWord=bench%21pw";
+
+const char *REQ_CHUNKED = "POST /index.html HTTP/1.1\r\n"
+                          "Host: 192.168.1.10:1316\r\n"
+                          "Connection: keep-alive\r\n"
+                          "Transfer-Encoding: chunked\r\n"
+                          "\r\n"
+                          "1a\r\nabcdefghijklmnopqrstuvwxyz\r\n"
+                          "a;ext=1\r\n0123456789\r\n"
+                          "0\r\n\r\n";
+
+void BM_BufferAppend(benchmark::State &state) {
+    const size_t len = state.range(0);
+    std::string data(len, 'x');
+    Buffer buff;
+    for (auto _ : state) {
+        buff.Append(data);
+        if (buff.ReadableBytes() > (1 << 20)) {
+            buff.RetrieveAll();
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * len);
+}
+BENCHMARK(BM_BufferAppend)->RangeMultiplier(4)->Range(16, 16 << 10);
+
+void BM_BufferReadFd(benchmark::State &state) {
+    const size_t len = state.range(0);
+    std::string data(len, 'x');
+    int fds[2];
+    if (pipe(fds) < 0) {
+        state.SkipWithError("pipe failed");
+        return;
+    }
+    Buffer buff;
+    int err = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        if (write(fds[1], data.data(), len) != static_cast<ssize_t>(len)) {
+            state.SkipWithError("write failed");
+            break;
+        }
+        state.ResumeTiming();
+        buff.ReadFd(fds[0], &err);
+        buff.Retrieve(buff.ReadableBytes());
+    }
+    state.SetBytesProcessed(state.iterations() * len);
+    close(fds[0]);
+    close(fds[1]);
+}
+BENCHMARK(BM_BufferReadFd)->RangeMultiplier(4)->Range(64, 64 << 10);
+
+void BM_HttpRequestParse(benchmark::State &state, const char *raw) {
+    static MemoryUserStore store;
+    static bool once = [] {
+        store.Register("bench", "bench!pw");
+        return true;
+    }();
+    (void)once;
+    HttpRequest::userStore = &store;
+    const size_t len = strlen(raw);
+    Buffer buff;
+    HttpRequest request;
+    for (auto _ : state) {
+        buff.Append(raw, len);
+        request.Init();
+        benchmark::DoNotOptimize(request.Parse(buff));
+        buff.Retrieve(buff.ReadableBytes());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * len);
+}
+BENCHMARK_CAPTURE(BM_HttpRequestParse, simple_get, REQ_SIMPLE);
+BENCHMARK_CAPTURE(BM_HttpRequestParse, browser_get, REQ_BROWSER);
+BENCHMARK_CAPTURE(BM_HttpRequestParse, login_post, REQ_LOGIN);
+BENCHMARK_CAPTURE(BM_HttpRequestParse, chunked_post, REQ_CHUNKED);
+
+/*小文件的200响应(内容在FileCache中)，参数为响应头缓存的字节数，0表示每次重新生成响应头*/
+void BM_HttpResponseRespond(benchmark::State &state) {
+    static std::string srcDir = [] {
+        char dir[] = "/tmp/microbench_resXXXXXX";
+        std::string path = mkdtemp(dir);
+        std::ofstream(path + "/index.html") << "<html><body>micro bench page</body></html>";
+        return path;
+    }();
+    FileCache::Instance()->Init(1 << 20, 64 << 10);
+    FileCache::Headers()->Init(state.range(0), 0);
+    Buffer buff;
+    HttpResponse response;
+    for (auto _ : state) {
+        response.Init(srcDir, "/index.html", true, 200);
+        response.SetAcceptEncoding("gzip, deflate, br");
+        response.Respond(buff);
+        buff.RetrieveAll();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HttpResponseRespond)->Arg(0)->Arg(1 << 20);
+
+void BM_HeapTimerAdd(benchmark::State &state) {
+    const int n = state.range(0);
+    for (auto _ : state) {
+        HeapTimer timer;
+        for (int i = 0; i < n; i++) {
+            timer.Add(i, 60000 + (i * 7919) % 10000, [] {});
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_HeapTimerAdd)->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+void BM_HeapTimerAdjust(benchmark::State &state) {
+    const int n = state.range(0);
+    HeapTimer timer;
+    for (int i = 0; i < n; i++) {
+        timer.Add(i, 60000 + (i * 7919) % 10000, [] {});
+    }
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> dist(0, n - 1);
+    for (auto _ : state) {
+        timer.Adjust(dist(rng), 70000);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HeapTimerAdjust)->Arg(10000)->Arg(100000)->Arg(1000000);
+
+void BM_HeapTimerTick(benchmark::State &state) {
+    const int n = state.range(0);
+    for (auto _ : state) {
+        state.PauseTiming();
+        HeapTimer timer;
+        for (int i = 0; i < n; i++) {
+            timer.Add(i, 0, [] {});
+        }
+        state.ResumeTiming();
+        timer.Tick(); //所有节点均已超时
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_HeapTimerTick)->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+void BM_ThreadPoolThroughput(benchmark::State &state) {
+    const int threads = state.range(0);
+    const int tasks = 100000;
+    ThreadPool pool(threads);
+    for (auto _ : state) {
+        std::atomic<int> done(0);
+        for (int i = 0; i < tasks; i++) {
+            pool.AddTask([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        while (done.load(std::memory_order_relaxed) < tasks) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * tasks);
+}
+BENCHMARK(BM_ThreadPoolThroughput)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/*日志在所有线程开始写之前初始化一次，在全部线程结束之后刷新*/
+template <int QueueSize>
+void LogSetup(const benchmark::State &) {
+    Log::Instance()->Init(1, "/tmp/webserver_bench_log", ".log", QueueSize);
+}
+
+void LogTeardown(const benchmark::State &) {
+    Log::Instance()->Flush();
+}
+
+void BM_LogWrite(benchmark::State &state) {
+    int i = 0;
+    for (auto _ : state) {
+        LOG_INFO("Client[%d](%s:%d) in, userCount:%d", i, "192.168.1.10", 40000 + i % 20000, i);
+        i++;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LogWrite)
+    ->Name("BM_LogWrite/sync")
+    ->Setup(LogSetup<0>)
+    ->Teardown(LogTeardown)
+    ->Threads(1)
+    ->Threads(4)
+    ->UseRealTime();
+BENCHMARK(BM_LogWrite)
+    ->Name("BM_LogWrite/async")
+    ->Setup(LogSetup<1024>)
+    ->Teardown(LogTeardown)
+    ->Threads(1)
+    ->Threads(4)
+    ->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
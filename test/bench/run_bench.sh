@@ -0,0 +1,84 @@
+#!/bin/bash
+# 端到端压测：在回环地址上以进程内用户存储启动服务器，依次运行固定的几组负载，
+# 结果写为JSON并与基线比对，超过阈值的性能回退以非零状态退出
+#
+# 环境变量：
+#   BENCH_PORT       服务器端口(默认19316)
+#   BENCH_DURATION   每组负载的时长，秒(默认5)
+#   BENCH_CONNS      连接数(默认64)
+#   BENCH_THRESHOLD  允许的回退百分比(默认10)
+#   BENCH_BASELINE   基线文件(默认test/bench/baseline.json)
+#   BENCH_OUT        结果目录(默认bin/bench)
+set -e
+
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+SERVER=$ROOT/bin/server_bench
+LOADGEN=$ROOT/bin/loadgen
+PORT=${BENCH_PORT:-19316}
+DURATION=${BENCH_DURATION:-5}
+CONNS=${BENCH_CONNS:-64}
+THRESHOLD=${BENCH_THRESHOLD:-10}
+BASELINE=${BENCH_BASELINE:-$ROOT/test/bench/baseline.json}
+OUT=${BENCH_OUT:-$ROOT/bin/bench}
+CPUS=$(nproc)
+THREADS=$(((CPUS + 1) / 2))
+URL=http://127.0.0.1:$PORT
+
+# 压测用的静态资源：2KB小文件、8MB大文件以及登录流程需要的页面
+WORKDIR=$(mktemp -d)
+mkdir -p "$WORKDIR/resources"
+head -c 2048 /dev/zero | tr '\0' 'a' > "$WORKDIR/resources/index.html"
+head -c 8388608 /dev/urandom > "$WORKDIR/resources/large.bin"
+for page in welcome error login register 400 403 404; do
+    echo "<html><body>$page</body></html>" > "$WORKDIR/resources/$page.html"
+done
+
+cleanup() {
+    if [ -n "$SERVER_PID" ]; then
+        kill "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+    fi
+    rm -rf "$WORKDIR"
+}
+trap cleanup EXIT
+
+# 服务器以资源目录的父目录为工作目录
+(cd "$WORKDIR" && exec "$SERVER" "$PORT" "$CPUS" 1 --user-store memory --log-level 2) &
+SERVER_PID=$!
+READY=0
+for _ in $(seq 50); do
+    # -d限定探测时长：连接被拒绝时loadgen会一直重连，直到时长用完
+    if "$LOADGEN" -n 1 -c 1 -t 1 -T 1 -d 1 "$URL/" > /dev/null 2>&1; then
+        READY=1
+        break
+    fi
+    # 服务器已经退出(如端口被占用)就不必再等
+    kill -0 "$SERVER_PID" 2>/dev/null || break
+    sleep 0.1
+done
+# 服务器没有起来时不要对着一个死端口压测，得到的结果没有意义；退出时由cleanup结束服务器进程
+if [ "$READY" != 1 ]; then
+    echo "server did not become ready on port $PORT" >&2
+    exit 1
+fi
+
+rm -rf "$OUT"
+mkdir -p "$OUT"
+
+run() {
+    local name=$1
+    shift
+    echo "== $name"
+    "$LOADGEN" -t "$THREADS" -d "$DURATION" -j "$OUT/$name.json" "$@"
+}
+
+FORM="Content-Type: application/x-www-form-urlencoded"
+"$LOADGEN" -n 1 -c 1 -t 1 -m POST -H "$FORM" -b "userName=bench&passWord=bench" "$URL/register" > /dev/null
+
+run small_keepalive -c "$CONNS" "$URL/index.html"
+run small_close -c "$CONNS" --close "$URL/index.html"
+run large_keepalive -c 8 "$URL/large.bin"
+run login_post -c "$CONNS" -m POST -H "$FORM" -b "userName=bench&passWord=bench" "$URL/login"
+
+python3 "$ROOT/test/bench/compare.py" --results "$OUT" --out "$OUT/results.json" \
+    --baseline "$BASELINE" --threshold "$THRESHOLD"
@@ -3,12 +3,22 @@
  * @Date         : 2020-06-20
  * @copyleft Apache 2.0
  */
+#include "../code/buffer/buffer.h"
+#include "../code/http/parse_http.h"
 #include "../code/log/log.h"
 #include "../code/pool/thread_pool.h"
+#include "../code/timer/heap_timer.h"
+#include <cassert>
+#include <cstring>
+#include <dirent.h>
 #include <features.h>
+#include <fstream>
 #include <sched.h>
+#include <string>
 #include <sys/syscall.h>
+#include <sys/wait.h>
 #include <unistd.h>
+#include <vector>
 
 pid_t gettid() {
     return syscall(SYS_gettid);
@@ -52,7 +62,185 @@ void TestThreadPool() {
     getchar();
 }
 
-int main() {
-    // TestLog();
-    TestThreadPool();
+/*追加的数据超过剩余空间时扩容，扩容后的数据完整*/
+void TestBufferGrow() {
+    Buffer buff(16);
+    std::string expect;
+    for (int i = 0; i < 100; i++) {
+        std::string piece(i % 37 + 1, static_cast<char>('a' + i % 26));
+        buff.Append(piece);
+        expect += piece;
+        if (i % 10 == 9) {
+            buff.Retrieve(5); //留出prepend区，交替走腾挪和扩容两条路径
+            expect.erase(0, 5);
+        }
+        assert(buff.ReadableBytes() == expect.size());
+    }
+    assert(buff.RetrieveAllToStr() == expect);
+}
+
+/*新节点逐个上浮到根节点，超时回调按到期时间顺序执行*/
+void TestHeapTimerSiftup() {
+    HeapTimer timer;
+    std::vector<int> fired;
+    const int n = 100;
+    for (int i = 0; i < n; i++) {
+        timer.Add(i, -i, [&fired, i] { fired.push_back(i); }); //后加入的更早到期
+    }
+    timer.Tick();
+    assert(fired.size() == static_cast<size_t>(n));
+    for (int i = 0; i < n; i++) {
+        assert(fired[i] == n - 1 - i);
+    }
+}
+
+/*一次收到整个请求时的解析结果*/
+HttpRequest::PARSE_RESULT ParseAll(HttpRequest &request, const std::string &data) {
+    Buffer buff;
+    buff.Append(data);
+    return request.Parse(buff);
+}
+
+/*逐字节到达时，最后一个字节之前都是NEED_MORE，之后请求完整，流水线中的下一个请求留在缓冲区中*/
+void TestParseIncremental(const std::string &data, const std::string &body, const std::string &next) {
+    HttpRequest request;
+    Buffer buff;
+    for (size_t i = 0; i < data.size(); i++) {
+        buff.Append(data.data() + i, 1);
+        HttpRequest::PARSE_RESULT result = request.Parse(buff);
+        assert(result == (i + 1 < data.size() ? HttpRequest::NEED_MORE : HttpRequest::COMPLETE));
+    }
+    assert(request.Body() == body && request.BodyLen() == body.size());
+    buff.Append(next);
+    request.Init();
+    assert(request.Parse(buff) == HttpRequest::COMPLETE);
+    assert(request.GetPath() == "/next" && buff.ReadableBytes() == 0);
+}
+
+/*Content-Length和chunked两种分帧，chunk扩展和trailer被忽略，消息体之后紧跟下一个请求*/
+void TestParseBody() {
+    const std::string next = "GET /next HTTP/1.1\r\nHost: x\r\n\r\n";
+    TestParseIncremental("POST /upload HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello", "hello", next);
+    TestParseIncremental("POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                         "5;name=value\r\nhello\r\nA \r\n, chunked!\r\n0\r\nX-Checksum: 1\r\nX-Other: 2\r\n\r\n",
+                         "hello, chunked!", next);
+
+    HttpRequest request;
+    Buffer buff;
+    buff.Append("POST /upload HTTP/1.1\r\nTransfer-Encoding: Chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n" + next);
+    assert(request.Parse(buff) == HttpRequest::COMPLETE && request.Body() == "abc");
+    request.Init();
+    assert(request.Parse(buff) == HttpRequest::COMPLETE && request.GetPath() == "/next");
+
+    /*名字不区分大小写，相同的Content-Length重复出现时不算冲突*/
+    request.Init();
+    buff.Append("POST /upload HTTP/1.1\r\ncontent-length: 3\r\nContent-Length: 3\r\nCONNECTION: keep-alive\r\n\r\nabc");
+    assert(request.Parse(buff) == HttpRequest::COMPLETE && request.Body() == "abc");
+    assert(request.GetHeader("Content-Length") == "3" && request.IsKeepAlive() && buff.ReadableBytes() == 0);
+}
+
+/*分帧有歧义或格式错误的请求被拒绝，并给出应答的状态码*/
+void TestParseFramingErrors() {
+    const struct {
+        const char *data;
+        int code;
+    } CASES[] = {
+        {"POST / HTTP/1.1\r\nContent-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n", 400},
+        {"POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 4\r\n\r\nabcd", 400},
+        /*名字只有大小写不同的重复字段，空的Content-Length和Transfer-Encoding*/
+        {"POST / HTTP/1.1\r\ncontent-length: 30\r\nContent-Length: 0\r\n\r\n", 400},
+        {"POST / HTTP/1.1\r\nContent-Length: 0\r\nCONTENT-LENGTH: 30\r\n\r\n", 400},
+        {"POST / HTTP/1.1\r\ntransfer-encoding: chunked\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n", 400},
+        {"POST / HTTP/1.1\r\ntransfer-encoding: chunked\r\nContent-Length: 3\r\n\r\n0\r\n\r\n", 400},
+        {"POST / HTTP/1.1\r\nContent-Length:\r\n\r\n", 400},
+        {"POST / HTTP/1.1\r\nTransfer-Encoding: \r\n\r\n", 400},
+        {"POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n", 400},
+        {"POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n", 501},
+        {"POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n", 400},
+        {"POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabcd\r\n", 400},
+        /*请求头的名字为空或含空白*/
+        {"POST / HTTP/1.1\r\nTransfer-Encoding : chunked\r\n\r\n0\r\n\r\n", 400},
+        {"POST / HTTP/1.1\r\nHost: x\r\n Transfer-Encoding: chunked\r\n\r\n0\r\n\r\n", 400},
+        {"GET / HTTP/1.1\r\nHost: x\r\n\tfolded: value\r\n\r\n", 400},
+        {"GET / HTTP/1.1\r\n: value\r\n\r\n", 400},
+    };
+    for (const auto &c : CASES) {
+        HttpRequest request;
+        assert(ParseAll(request, c.data) == HttpRequest::INVALID && request.ErrorCode() == c.code);
+    }
+}
+
+/*trailer的总长度与请求头一样以MAX_HEADER_BYTES为上限，刚好到达上限后的一行也要拒绝*/
+void TestParseTrailerLimit() {
+    const std::string head = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n";
+    const size_t MAX = HttpRequest::MAX_HEADER_BYTES;
+    std::string first = "X-Pad: " + std::string(MAX - 12 - 7, 'a') + "\r\n"; //之后只剩10字节，含CRLF
+    HttpRequest request;
+    assert(ParseAll(request, head + first + "X-Last:1\r\n\r\n") == HttpRequest::COMPLETE);
+    request.Init();
+    assert(ParseAll(request, head + first + "X-Last: 1\r\n\r\n") == HttpRequest::INVALID &&
+           request.ErrorCode() == 400);
+    /*没有CRLF的超长trailer行不会一直等待*/
+    request.Init();
+    assert(ParseAll(request, head + "X-Pad: " + std::string(MAX, 'a')) == HttpRequest::INVALID);
+    /*chunk大小行同样有上限*/
+    request.Init();
+    assert(ParseAll(request, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n1;" +
+                                 std::string(HttpRequest::MAX_CHUNK_LINE, 'e')) == HttpRequest::INVALID);
+}
+
+/*异步日志在进程正常退出时写完队列中的日志，而不是调用terminate*/
+void TestLogAsyncExit() {
+    char dir[] = "/tmp/webserver_test_log_XXXXXX";
+    assert(mkdtemp(dir));
+    const int lines = 1000;
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        Log::Instance()->Init(1, dir, ".log", 1024);
+        for (int i = 0; i < lines; i++) {
+            LOG_INFO("async exit test %d", i);
+        }
+        exit(0);
+    }
+    int status;
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    int count = 0;
+    DIR *d = opendir(dir);
+    assert(d);
+    while (struct dirent *ent = readdir(d)) {
+        if (ent->d_name[0] == '.') {
+            continue;
+        }
+        std::string path = std::string(dir) + "/" + ent->d_name;
+        std::ifstream in(path);
+        for (std::string line; std::getline(in, line);) {
+            count += line.find("async exit test") != std::string::npos;
+        }
+        unlink(path.c_str());
+    }
+    closedir(d);
+    rmdir(dir);
+    assert(count == lines);
+}
+
+int main(int argc, char *argv[]) {
+    /*make unittest运行下面的回归测试；日志和线程池的演示需要手工检查输出，以参数选择*/
+    if (argc > 1 && strcmp(argv[1], "log") == 0) {
+        TestLog();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "threadpool") == 0) {
+        TestThreadPool();
+        return 0;
+    }
+    TestLogAsyncExit(); //fork之前不能有其他线程
+    TestBufferGrow();
+    TestHeapTimerSiftup();
+    TestParseBody();
+    TestParseFramingErrors();
+    TestParseTrailerLimit();
+    printf("all tests passed\n");
+    return 0;
 }
\ No newline at end of file
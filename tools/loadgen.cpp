@@ -0,0 +1,744 @@
+/*
+ * 基于epoll的多线程HTTP压测工具，替代webbench
+ * 支持keep-alive、流水线，闭环(每个连接收到响应后再发下一个请求)与
+ * 开环(按固定速率发送，延迟从计划发送时刻算起，避免协调遗漏)两种模式，
+ * 用HdrHistogram统计延迟百分位，并可输出JSON结果
+ */
+#include "../code/utils/hdr_histogram.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/*延迟以微秒记录，最大60秒，3位有效数字*/
+const int64_t HIST_LOWEST_US = 1;
+const int64_t HIST_HIGHEST_US = 60 * 1000 * 1000;
+const int HIST_SIGFIGS = 3;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 80;
+    std::string path = "/";
+    std::string method = "GET";
+    std::string body;
+    std::vector<std::string> headers;
+    int connections = 64;
+    int threads = 4;
+    double duration = 10;    //秒
+    long long requests = 0;  //总请求数上限，0表示只受时长限制
+    double rate = 0;         //开环模式的总请求速率(次/秒)，0表示闭环
+    int pipeline = 1;        //每个连接上未完成请求的最大数目
+    bool keepAlive = true;
+    double timeout = 5;      //单个连接无响应的超时(秒)
+    std::string jsonPath;    //JSON结果输出文件，"-"表示标准输出
+};
+
+int64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+enum ConnState { CLOSED = 0, CONNECTING, OPEN };
+
+struct Conn {
+    int fd = -1;
+    ConnState state = CLOSED;
+    std::string out;      //待发送数据
+    size_t outOff = 0;
+    std::string in;       //已接收未解析的数据
+    std::deque<int64_t> starts; //未完成请求的起始时刻(开环为计划时刻，闭环为实际发送时刻)
+    int64_t lastActive = 0;
+    bool broken = false;  //发送出错，等待事件循环重连
+    /*响应解析状态*/
+    bool headerDone = false;
+    long long bodyRemaining = 0;
+    bool untilEof = false; //没有Content-length且对端会关闭连接
+    bool chunked = false;  //Transfer-Encoding: chunked，bodyRemaining为当前chunk剩余的字节数(含结尾CRLF)
+    bool lastChunk = false; //已读到长度为0的chunk，之后是trailer
+    bool closeAfter = false;
+    int status = 0;
+};
+
+struct WorkerStats {
+    HdrHistogram latency{HIST_LOWEST_US, HIST_HIGHEST_US, HIST_SIGFIGS};
+    long long completed = 0;
+    long long errors = 0;
+    long long connectErrors = 0;
+    long long timeouts = 0;
+    long long reconnects = 0;
+    long long bytesRead = 0;
+    long long status[6] = {0}; // 1xx..5xx，下标0为无法识别
+};
+
+class Worker
+{
+public:
+    Worker(const Options &opt, const sockaddr_in &addr, const std::string &request, int connCount, double rate,
+           std::atomic<long long> *budget)
+        : m_opt(opt), m_addr(addr), m_request(request), m_conns(connCount), m_rate(rate), m_budget(budget) {
+    }
+
+    void Run(int64_t startNs, int64_t endNs);
+    WorkerStats &Stats() {
+        return m_stats;
+    }
+
+private:
+    const Options &m_opt;
+    sockaddr_in m_addr;
+    const std::string &m_request;
+    std::vector<Conn> m_conns;
+    double m_rate;
+    std::atomic<long long> *m_budget; //剩余可发送请求数，所有线程共享
+    int m_epfd = -1;
+    bool m_stopping = false;
+    std::deque<int64_t> m_backlog; //开环模式下已到计划时刻但没有空闲连接的请求
+    size_t m_nextConn = 0;
+    WorkerStats m_stats;
+
+    bool TakeBudget();
+    void Connect(Conn &c);
+    void CloseConn(Conn &c, bool failOutstanding);
+    void Reconnect(Conn &c);
+    void Send(Conn &c, int64_t start);
+    void Flush(Conn &c);
+    void OnReadable(Conn &c);
+    bool ParseResponses(Conn &c);
+    /*从off开始解析chunked消息体，整个消息体都已收到时返回true*/
+    bool ParseChunks(Conn &c, size_t &off);
+    void Complete(Conn &c);
+    void FillClosedLoop(Conn &c);
+    void DispatchBacklog();
+    bool Idle() const;
+};
+
+bool Worker::TakeBudget() {
+    if (m_stopping) {
+        return false;
+    }
+    if (!m_budget) {
+        return true;
+    }
+    if (m_budget->fetch_sub(1, std::memory_order_relaxed) > 0) {
+        return true;
+    }
+    m_stopping = true;
+    return false;
+}
+
+void Worker::Connect(Conn &c) {
+    c = Conn();
+    c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c.fd < 0) {
+        m_stats.connectErrors++;
+        return;
+    }
+    int one = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int ret = connect(c.fd, reinterpret_cast<const sockaddr *>(&m_addr), sizeof(m_addr));
+    if (ret < 0 && errno != EINPROGRESS) {
+        m_stats.connectErrors++;
+        close(c.fd);
+        c.fd = -1;
+        return;
+    }
+    c.state = CONNECTING;
+    c.lastActive = NowNs();
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+    ev.data.ptr = &c;
+    epoll_ctl(m_epfd, EPOLL_CTL_ADD, c.fd, &ev);
+}
+
+void Worker::CloseConn(Conn &c, bool failOutstanding) {
+    if (c.fd >= 0) {
+        epoll_ctl(m_epfd, EPOLL_CTL_DEL, c.fd, nullptr);
+        close(c.fd);
+    }
+    if (failOutstanding) {
+        m_stats.errors += c.starts.size();
+    }
+    c.starts.clear();
+    c.fd = -1;
+    c.state = CLOSED;
+}
+
+void Worker::Reconnect(Conn &c) {
+    CloseConn(c, true);
+    if (m_stopping) {
+        return;
+    }
+    m_stats.reconnects++;
+    Connect(c);
+}
+
+void Worker::Send(Conn &c, int64_t start) {
+    if (c.starts.empty()) {
+        c.lastActive = NowNs();
+    }
+    c.out.append(m_request);
+    c.starts.push_back(start);
+    Flush(c);
+}
+
+void Worker::Flush(Conn &c) {
+    if (c.state != OPEN) {
+        return;
+    }
+    while (c.outOff < c.out.size()) {
+        ssize_t n = send(c.fd, c.out.data() + c.outOff, c.out.size() - c.outOff, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            c.broken = true;
+            return;
+        }
+        c.outOff += n;
+    }
+    if (c.outOff == c.out.size()) {
+        c.out.clear();
+        c.outOff = 0;
+    }
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | (c.out.empty() ? 0 : EPOLLOUT);
+    ev.data.ptr = &c;
+    epoll_ctl(m_epfd, EPOLL_CTL_MOD, c.fd, &ev);
+}
+
+void Worker::Complete(Conn &c) {
+    int64_t now = NowNs();
+    if (!c.starts.empty()) {
+        m_stats.latency.Record((now - c.starts.front()) / 1000);
+        c.starts.pop_front();
+    }
+    m_stats.completed++;
+    int cls = c.status / 100;
+    m_stats.status[(cls >= 1 && cls <= 5) ? cls : 0]++;
+    c.headerDone = false;
+    c.bodyRemaining = 0;
+    c.untilEof = false;
+    c.chunked = false;
+    c.lastChunk = false;
+    c.status = 0;
+}
+
+/*解析缓冲区中所有完整的响应，返回false表示连接需要关闭*/
+bool Worker::ParseResponses(Conn &c) {
+    size_t off = 0;
+    while (true) {
+        if (!c.headerDone) {
+            size_t end = c.in.find("\r\n\r\n", off);
+            if (end == std::string::npos) {
+                break;
+            }
+            const char *p = c.in.data() + off;
+            c.status = 0;
+            if (c.in.compare(off, 5, "HTTP/") == 0) {
+                const char *sp = static_cast<const char *>(memchr(p, ' ', end - off));
+                if (sp) {
+                    c.status = atoi(sp + 1);
+                }
+            }
+            long long contentLength = -1;
+            c.closeAfter = !m_opt.keepAlive;
+            size_t line = c.in.find("\r\n", off);
+            while (line != std::string::npos && line < end) {
+                size_t next = c.in.find("\r\n", line + 2);
+                const char *h = c.in.data() + line + 2;
+                size_t len = next - line - 2;
+                if (len > 15 && strncasecmp(h, "content-length:", 15) == 0) {
+                    contentLength = atoll(h + 15);
+                } else if (len > 18 && strncasecmp(h, "transfer-encoding:", 18) == 0) {
+                    c.chunked = std::string(h + 18, len - 18).find("chunked") != std::string::npos;
+                } else if (len > 11 && strncasecmp(h, "connection:", 11) == 0) {
+                    std::string v(h + 11, len - 11);
+                    c.closeAfter = (v.find("close") != std::string::npos);
+                }
+                line = next;
+            }
+            off = end + 4;
+            c.headerDone = true;
+            if (c.chunked) {
+                c.bodyRemaining = 0;
+                c.untilEof = false;
+            } else if (contentLength >= 0) {
+                c.bodyRemaining = contentLength;
+                c.untilEof = false;
+            } else {
+                c.bodyRemaining = 0;
+                c.untilEof = c.closeAfter;
+            }
+        }
+        if (c.untilEof) {
+            off = c.in.size();
+            break;
+        }
+        if (c.chunked) {
+            if (!ParseChunks(c, off)) {
+                break;
+            }
+        } else {
+            long long avail = static_cast<long long>(c.in.size() - off);
+            if (avail < c.bodyRemaining) {
+                c.bodyRemaining -= avail;
+                off = c.in.size();
+                break;
+            }
+            off += c.bodyRemaining;
+            c.bodyRemaining = 0;
+        }
+        bool closeAfter = c.closeAfter;
+        Complete(c);
+        if (closeAfter) {
+            c.in.clear();
+            return false;
+        }
+        if (m_rate <= 0) {
+            FillClosedLoop(c);
+        }
+        if (c.broken) {
+            return false;
+        }
+    }
+    c.in.erase(0, off);
+    return true;
+}
+
+bool Worker::ParseChunks(Conn &c, size_t &off) {
+    while (true) {
+        if (c.bodyRemaining > 0) {
+            long long avail = static_cast<long long>(c.in.size() - off);
+            if (avail < c.bodyRemaining) {
+                c.bodyRemaining -= avail;
+                off = c.in.size();
+                return false;
+            }
+            off += c.bodyRemaining;
+            c.bodyRemaining = 0;
+        }
+        size_t eol = c.in.find("\r\n", off);
+        if (eol == std::string::npos) {
+            return false;
+        }
+        size_t line = off;
+        off = eol + 2;
+        if (c.lastChunk) {
+            if (eol == line) {
+                return true; //trailer之后的空行
+            }
+            continue;
+        }
+        long long size = strtoll(c.in.c_str() + line, nullptr, 16);
+        if (size == 0) {
+            c.lastChunk = true;
+        } else {
+            c.bodyRemaining = size + 2;
+        }
+    }
+}
+
+void Worker::OnReadable(Conn &c) {
+    char buf[65536];
+    while (true) {
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            m_stats.bytesRead += n;
+            c.in.append(buf, n);
+            c.lastActive = NowNs();
+            continue;
+        }
+        if (n == 0) {
+            /*对端关闭：先解析已收到的数据，没有Content-length的响应以EOF结束*/
+            if (ParseResponses(c) && c.headerDone && c.untilEof) {
+                Complete(c);
+            }
+            Reconnect(c);
+            return;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        Reconnect(c);
+        return;
+    }
+    if (!ParseResponses(c)) {
+        Reconnect(c);
+    }
+}
+
+void Worker::FillClosedLoop(Conn &c) {
+    while (c.state == OPEN && static_cast<int>(c.starts.size()) < m_opt.pipeline && TakeBudget()) {
+        Send(c, NowNs());
+    }
+}
+
+void Worker::DispatchBacklog() {
+    size_t n = m_conns.size();
+    size_t tried = 0;
+    while (!m_backlog.empty() && tried < n) {
+        Conn &c = m_conns[m_nextConn];
+        m_nextConn = (m_nextConn + 1) % n;
+        if (c.state == OPEN && !c.broken && static_cast<int>(c.starts.size()) < m_opt.pipeline) {
+            Send(c, m_backlog.front());
+            m_backlog.pop_front();
+            tried = 0;
+        } else {
+            tried++;
+        }
+    }
+}
+
+bool Worker::Idle() const {
+    for (const Conn &c : m_conns) {
+        if (!c.starts.empty()) {
+            return false;
+        }
+    }
+    return m_backlog.empty();
+}
+
+void Worker::Run(int64_t startNs, int64_t endNs) {
+    m_epfd = epoll_create1(EPOLL_CLOEXEC);
+    for (Conn &c : m_conns) {
+        Connect(c);
+    }
+    const int64_t interval = m_rate > 0 ? static_cast<int64_t>(1e9 / m_rate) : 0;
+    int64_t nextSend = startNs;
+    const int64_t timeoutNs = static_cast<int64_t>(m_opt.timeout * 1e9);
+    const int64_t drainDeadline = endNs + timeoutNs;
+    std::vector<epoll_event> events(256);
+    while (true) {
+        int64_t now = NowNs();
+        if (now >= endNs) {
+            m_stopping = true;
+        }
+        if (m_stopping && (Idle() || now >= drainDeadline)) {
+            break;
+        }
+        int waitMs = 100;
+        if (interval > 0 && !m_stopping) {
+            int64_t delta = (nextSend - now) / 1000000;
+            waitMs = delta < 0 ? 0 : (delta < waitMs ? static_cast<int>(delta) : waitMs);
+        }
+        int n = epoll_wait(m_epfd, events.data(), static_cast<int>(events.size()), waitMs);
+        for (int i = 0; i < n; i++) {
+            Conn &c = *static_cast<Conn *>(events[i].data.ptr);
+            uint32_t ev = events[i].events;
+            if (c.fd < 0) {
+                continue;
+            }
+            if (c.state == CONNECTING) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0 || (ev & (EPOLLERR | EPOLLHUP))) {
+                    m_stats.connectErrors++;
+                    CloseConn(c, true);
+                    if (!m_stopping) {
+                        Connect(c);
+                    }
+                    continue;
+                }
+                c.state = OPEN;
+                Flush(c);
+                if (m_rate <= 0) {
+                    FillClosedLoop(c);
+                }
+                if (c.broken) {
+                    Reconnect(c);
+                }
+                continue;
+            }
+            if (ev & EPOLLIN) {
+                OnReadable(c);
+            } else if (ev & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+                Reconnect(c);
+            }
+            if (c.fd >= 0 && (ev & EPOLLOUT)) {
+                Flush(c);
+            }
+            if (c.broken) {
+                Reconnect(c);
+            }
+        }
+        now = NowNs();
+        if (interval > 0 && !m_stopping) {
+            /*开环：按计划时刻生成请求，没有空闲连接时进入积压队列，延迟仍从计划时刻算起*/
+            while (nextSend <= now && TakeBudget()) {
+                m_backlog.push_back(nextSend);
+                nextSend += interval;
+            }
+        }
+        DispatchBacklog();
+        /*检查超时连接*/
+        for (Conn &c : m_conns) {
+            if (c.broken) {
+                Reconnect(c);
+            } else if (c.fd >= 0 && (!c.starts.empty() || c.state == CONNECTING) && now - c.lastActive > timeoutNs) {
+                m_stats.timeouts++;
+                Reconnect(c);
+            } else if (c.fd < 0 && !m_stopping) {
+                Connect(c);
+            }
+        }
+    }
+    m_stats.errors += m_backlog.size();
+    for (Conn &c : m_conns) {
+        CloseConn(c, true);
+    }
+    close(m_epfd);
+}
+
+void Usage(const char *name) {
+    printf("usage: %s [options] http://host:port/path\n", name);
+    printf("  -c, --connections <n>  total connections (default 64)\n");
+    printf("  -t, --threads <n>      worker threads (default 4)\n");
+    printf("  -d, --duration <s>     test duration in seconds (default 10)\n");
+    printf("  -n, --requests <n>     stop after n requests\n");
+    printf("  -R, --rate <rps>       open-loop constant request rate, 0 for closed-loop (default 0)\n");
+    printf("  -P, --pipeline <n>     max outstanding requests per connection (default 1)\n");
+    printf("      --close            send Connection: close, one request per connection\n");
+    printf("  -m, --method <m>       request method (default GET)\n");
+    printf("  -b, --body <data>      request body\n");
+    printf("  -H, --header <h>       extra request header, repeatable\n");
+    printf("  -T, --timeout <s>      response timeout (default 5)\n");
+    printf("  -j, --json <file>      write results as JSON, '-' for stdout\n");
+}
+
+bool ParseUrl(const std::string &url, Options &opt) {
+    const std::string scheme = "http://";
+    if (url.compare(0, scheme.size(), scheme) != 0) {
+        return false;
+    }
+    std::string rest = url.substr(scheme.size());
+    size_t slash = rest.find('/');
+    std::string hostPort = rest.substr(0, slash);
+    opt.path = slash == std::string::npos ? "/" : rest.substr(slash);
+    size_t colon = hostPort.find(':');
+    opt.host = hostPort.substr(0, colon);
+    opt.port = colon == std::string::npos ? 80 : atoi(hostPort.c_str() + colon + 1);
+    return !opt.host.empty() && opt.port > 0;
+}
+
+std::string BuildRequest(const Options &opt) {
+    std::string req = opt.method + " " + opt.path + " HTTP/1.1\r\n";
+    req += "Host: " + opt.host + ":" + std::to_string(opt.port) + "\r\n";
+    req += opt.keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    for (const std::string &h : opt.headers) {
+        req += h + "\r\n";
+    }
+    if (!opt.body.empty()) {
+        req += "Content-Length: " + std::to_string(opt.body.size()) + "\r\n";
+    }
+    req += "\r\n";
+    req += opt.body;
+    return req;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    static const struct option longOptions[] = {
+        {"connections", required_argument, nullptr, 'c'},
+        {"threads", required_argument, nullptr, 't'},
+        {"duration", required_argument, nullptr, 'd'},
+        {"requests", required_argument, nullptr, 'n'},
+        {"rate", required_argument, nullptr, 'R'},
+        {"pipeline", required_argument, nullptr, 'P'},
+        {"close", no_argument, nullptr, 'C'},
+        {"method", required_argument, nullptr, 'm'},
+        {"body", required_argument, nullptr, 'b'},
+        {"header", required_argument, nullptr, 'H'},
+        {"timeout", required_argument, nullptr, 'T'},
+        {"json", required_argument, nullptr, 'j'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+    Options opt;
+    bool durationSet = false;
+    int ch;
+    while ((ch = getopt_long(argc, argv, "c:t:d:n:R:P:m:b:H:T:j:h", longOptions, nullptr)) != -1) {
+        switch (ch) {
+            case 'c':
+                opt.connections = atoi(optarg);
+                break;
+            case 't':
+                opt.threads = atoi(optarg);
+                break;
+            case 'd':
+                opt.duration = atof(optarg);
+                durationSet = true;
+                break;
+            case 'n':
+                opt.requests = atoll(optarg);
+                break;
+            case 'R':
+                opt.rate = atof(optarg);
+                break;
+            case 'P':
+                opt.pipeline = atoi(optarg);
+                break;
+            case 'C':
+                opt.keepAlive = false;
+                break;
+            case 'm':
+                opt.method = optarg;
+                break;
+            case 'b':
+                opt.body = optarg;
+                break;
+            case 'H':
+                opt.headers.push_back(optarg);
+                break;
+            case 'T':
+                opt.timeout = atof(optarg);
+                break;
+            case 'j':
+                opt.jsonPath = optarg;
+                break;
+            default:
+                Usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - 1 || !ParseUrl(argv[optind], opt)) {
+        Usage(argv[0]);
+        return 1;
+    }
+    if (opt.requests > 0 && !durationSet) {
+        opt.duration = 86400;
+    }
+    if (!opt.keepAlive) {
+        opt.pipeline = 1;
+    }
+    if (opt.threads < 1 || opt.connections < opt.threads || opt.pipeline < 1 || opt.duration <= 0) {
+        fprintf(stderr, "invalid options: need threads >= 1, connections >= threads, pipeline >= 1\n");
+        return 1;
+    }
+
+    struct addrinfo hints = {}, *res = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(opt.host.c_str(), nullptr, &hints, &res) != 0 || !res) {
+        fprintf(stderr, "cannot resolve %s\n", opt.host.c_str());
+        return 1;
+    }
+    sockaddr_in addr = *reinterpret_cast<sockaddr_in *>(res->ai_addr);
+    addr.sin_port = htons(opt.port);
+    freeaddrinfo(res);
+
+    const std::string request = BuildRequest(opt);
+    std::atomic<long long> budget(opt.requests);
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < opt.threads; i++) {
+        int conns = opt.connections / opt.threads + (i < opt.connections % opt.threads ? 1 : 0);
+        workers.emplace_back(new Worker(opt, addr, request, conns, opt.rate / opt.threads,
+                                        opt.requests > 0 ? &budget : nullptr));
+    }
+    const int64_t startNs = NowNs();
+    const int64_t endNs = startNs + static_cast<int64_t>(opt.duration * 1e9);
+    std::vector<std::thread> threads;
+    for (auto &w : workers) {
+        Worker *worker = w.get();
+        threads.emplace_back([worker, startNs, endNs] { worker->Run(startNs, endNs); });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    const double elapsed = (NowNs() - startNs) / 1e9;
+
+    WorkerStats total;
+    for (auto &w : workers) {
+        WorkerStats &s = w->Stats();
+        total.latency.Merge(s.latency);
+        total.completed += s.completed;
+        total.errors += s.errors;
+        total.connectErrors += s.connectErrors;
+        total.timeouts += s.timeouts;
+        total.reconnects += s.reconnects;
+        total.bytesRead += s.bytesRead;
+        for (int i = 0; i < 6; i++) {
+            total.status[i] += s.status[i];
+        }
+    }
+    const HdrHistogram &h = total.latency;
+    const double rps = total.completed / elapsed;
+    const double mbps = total.bytesRead / elapsed / (1024.0 * 1024.0);
+
+    printf("%s %s:%d%s, %d threads, %d connections, pipeline %d, %s, %s\n", opt.method.c_str(), opt.host.c_str(),
+           opt.port, opt.path.c_str(), opt.threads, opt.connections, opt.pipeline,
+           opt.keepAlive ? "keep-alive" : "close",
+           opt.rate > 0 ? ("open-loop " + std::to_string(static_cast<long long>(opt.rate)) + " rps").c_str()
+                        : "closed-loop");
+    printf("  %lld requests in %.2fs, %.2f MB read, %.1f req/s, %.2f MB/s\n", total.completed, elapsed,
+           total.bytesRead / (1024.0 * 1024.0), rps, mbps);
+    printf("  latency(us) min %lld mean %.1f p50 %lld p90 %lld p99 %lld p999 %lld max %lld\n",
+           static_cast<long long>(h.Min()), h.Mean(), static_cast<long long>(h.ValueAtPercentile(50)),
+           static_cast<long long>(h.ValueAtPercentile(90)), static_cast<long long>(h.ValueAtPercentile(99)),
+           static_cast<long long>(h.ValueAtPercentile(99.9)), static_cast<long long>(h.Max()));
+    printf("  status 2xx %lld 3xx %lld 4xx %lld 5xx %lld other %lld, errors %lld, connect errors %lld, timeouts %lld\n",
+           total.status[2], total.status[3], total.status[4], total.status[5], total.status[0] + total.status[1],
+           total.errors, total.connectErrors, total.timeouts);
+
+    if (!opt.jsonPath.empty()) {
+        FILE *fp = opt.jsonPath == "-" ? stdout : fopen(opt.jsonPath.c_str(), "w");
+        if (!fp) {
+            fprintf(stderr, "cannot open %s\n", opt.jsonPath.c_str());
+            return 1;
+        }
+        fprintf(fp,
+                "{\n"
+                "  \"url\": \"http://%s:%d%s\",\n"
+                "  \"method\": \"%s\",\n"
+                "  \"mode\": \"%s\",\n"
+                "  \"rate\": %.1f,\n"
+                "  \"threads\": %d,\n"
+                "  \"connections\": %d,\n"
+                "  \"pipeline\": %d,\n"
+                "  \"keep_alive\": %s,\n"
+                "  \"duration_s\": %.3f,\n"
+                "  \"requests\": %lld,\n"
+                "  \"errors\": %lld,\n"
+                "  \"connect_errors\": %lld,\n"
+                "  \"timeouts\": %lld,\n"
+                "  \"reconnects\": %lld,\n"
+                "  \"bytes\": %lld,\n"
+                "  \"requests_per_sec\": %.1f,\n"
+                "  \"mb_per_sec\": %.3f,\n"
+                "  \"status\": {\"2xx\": %lld, \"3xx\": %lld, \"4xx\": %lld, \"5xx\": %lld, \"other\": %lld},\n"
+                "  \"latency_us\": {\"min\": %lld, \"mean\": %.1f, \"p50\": %lld, \"p90\": %lld, \"p99\": %lld, "
+                "\"p999\": %lld, \"max\": %lld}\n"
+                "}\n",
+                opt.host.c_str(), opt.port, opt.path.c_str(), opt.method.c_str(),
+                opt.rate > 0 ? "open" : "closed", opt.rate, opt.threads, opt.connections, opt.pipeline,
+                opt.keepAlive ? "true" : "false", elapsed, total.completed, total.errors, total.connectErrors,
+                total.timeouts, total.reconnects, total.bytesRead, rps, mbps, total.status[2], total.status[3],
+                total.status[4], total.status[5], total.status[0] + total.status[1],
+                static_cast<long long>(h.Min()), h.Mean(), static_cast<long long>(h.ValueAtPercentile(50)),
+                static_cast<long long>(h.ValueAtPercentile(90)), static_cast<long long>(h.ValueAtPercentile(99)),
+                static_cast<long long>(h.ValueAtPercentile(99.9)), static_cast<long long>(h.Max()));
+        if (fp != stdout) {
+            fclose(fp);
+        }
+    }
+    return total.completed > 0 ? 0 : 2;
+}
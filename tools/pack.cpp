@@ -0,0 +1,300 @@
+/*
+ * 静态资源打包工具：把资源目录打包成服务器以--pack加载的单个文件(格式见code/http/asset_pack.h)
+ * 可压缩的文件以最高压缩级别预先生成.gz/.br条目，目录中已有的预压缩文件原样打包；
+ * 每个条目的200响应实体头部也在打包时生成，与服务器生成的相同；
+ * 先写临时文件再rename，替换正在使用的包是原子的
+ * 用法：pack <资源目录> <输出文件>
+ */
+#include "../code/http/asset_pack.h"
+#include "../code/http/entity_headers.h"
+#include "../code/utils/str_hash.h"
+#include <algorithm>
+#ifndef NO_BROTLI
+#include <brotli/encode.h>
+#endif
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+/*比它小的文件不压缩；压缩后不小于原大小的这个比例时不保留压缩结果(图片、视频等)*/
+const size_t MIN_COMPRESS_SIZE = 256;
+const double MAX_COMPRESS_RATIO = 0.9;
+
+struct Asset {
+    std::string path; //以'/'开头，相对资源目录
+    std::string data;
+    struct timespec mtime;
+};
+
+bool ReadFile(const std::string &file, std::string &data) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::ostringstream out;
+    out << in.rdbuf();
+    data = out.str();
+    return true;
+}
+
+/*递归收集目录下其他用户可读的普通文件，服务器对不可读的文件返回403，不打包*/
+bool Collect(const std::string &root, const std::string &rel, std::vector<Asset> &assets) {
+    DIR *dir = opendir((root + rel).c_str());
+    if (!dir) {
+        fprintf(stderr, "opendir %s: %s\n", (root + rel).c_str(), strerror(errno));
+        return false;
+    }
+    bool ok = true;
+    while (struct dirent *ent = readdir(dir)) {
+        std::string name = ent->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        std::string path = rel + "/" + name;
+        struct stat st;
+        if (stat((root + path).c_str(), &st) < 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            ok = Collect(root, path, assets) && ok;
+        } else if (S_ISREG(st.st_mode) && (st.st_mode & S_IROTH)) {
+            Asset asset;
+            asset.path = path;
+            asset.mtime = st.st_mtim;
+            if (!ReadFile(root + path, asset.data)) {
+                fprintf(stderr, "read %s failed\n", (root + path).c_str());
+                ok = false;
+                continue;
+            }
+            assets.push_back(std::move(asset));
+        }
+    }
+    closedir(dir);
+    return ok;
+}
+
+bool Gzip(const std::string &in, std::string &out) {
+    z_stream stream = {};
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&stream, in.size()));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+    stream.avail_in = in.size();
+    stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    stream.avail_out = out.size();
+    int ret = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    out.resize(stream.total_out);
+    return ret == Z_STREAM_END;
+}
+
+bool Brotli(const std::string &in, std::string &out) {
+#ifdef NO_BROTLI
+    (void)in;
+    (void)out;
+    return false;
+#else
+    size_t len = BrotliEncoderMaxCompressedSize(in.size());
+    out.resize(len);
+    if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC, in.size(),
+                               reinterpret_cast<const uint8_t *>(in.data()), &len,
+                               reinterpret_cast<uint8_t *>(&out[0]))) {
+        return false;
+    }
+    out.resize(len);
+    return true;
+#endif
+}
+
+uint64_t ContentHash(const std::string &data) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char ch : data) {
+        hash = (hash ^ ch) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*为可压缩的文件生成预压缩条目，修改时间与原文件相同；文件类型的判断与服务器协商编码时相同，
+ *图片、视频等不压缩*/
+void AddVariants(std::vector<Asset> &assets) {
+    std::vector<std::string> paths;
+    for (const Asset &a : assets) {
+        paths.push_back(a.path);
+    }
+    std::sort(paths.begin(), paths.end());
+    size_t count = assets.size();
+    for (size_t i = 0; i < count; i++) {
+        if (assets[i].data.size() < MIN_COMPRESS_SIZE || !Compressible(assets[i].path)) {
+            continue;
+        }
+        const char *SUFFIXES[] = {".gz", ".br"};
+        for (const char *suffix : SUFFIXES) {
+            std::string path = assets[i].path + suffix;
+            if (std::binary_search(paths.begin(), paths.end(), path)) {
+                continue; //目录中已有预压缩文件
+            }
+            std::string out;
+            bool ok = suffix[1] == 'g' ? Gzip(assets[i].data, out) : Brotli(assets[i].data, out);
+            if (!ok || out.size() >= assets[i].data.size() * MAX_COMPRESS_RATIO) {
+                continue;
+            }
+            Asset variant;
+            variant.path = path;
+            variant.data = std::move(out);
+            variant.mtime = assets[i].mtime;
+            assets.push_back(std::move(variant));
+        }
+    }
+}
+
+/*path是资源包中另一个可压缩文件的预压缩版本时，返回它的Content-Encoding，base为原文件路径*/
+const char *VariantEncoding(const std::string &path, const std::vector<std::string> &sorted, std::string &base) {
+    const char *encoding = nullptr;
+    if (path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0) {
+        encoding = "gzip";
+    } else if (path.size() > 3 && path.compare(path.size() - 3, 3, ".br") == 0) {
+        encoding = "br";
+    } else {
+        return nullptr;
+    }
+    base = path.substr(0, path.size() - 3);
+    if (!Compressible(base) || !std::binary_search(sorted.begin(), sorted.end(), base)) {
+        return nullptr;
+    }
+    return encoding;
+}
+
+size_t Align(size_t offset) {
+    return (offset + PACK_ALIGN - 1) / PACK_ALIGN * PACK_ALIGN;
+}
+
+bool Write(const std::vector<Asset> &assets, const std::string &file) {
+    PackHeader header = {};
+    memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.version = PACK_VERSION;
+    header.count = assets.size();
+    header.slots = 2;
+    while (header.slots < header.count * 2) {
+        header.slots <<= 1;
+    }
+    std::vector<PackEntry> entries(assets.size());
+    std::vector<uint32_t> slots(header.slots, 0);
+    size_t offset = sizeof(PackHeader) + entries.size() * sizeof(PackEntry) + slots.size() * sizeof(uint32_t);
+    for (size_t i = 0; i < assets.size(); i++) {
+        entries[i].pathOffset = offset;
+        entries[i].pathLen = assets[i].path.size();
+        entries[i].pathHash = StrHash(assets[i].path.data(), assets[i].path.size());
+        offset += assets[i].path.size();
+        uint32_t mask = header.slots - 1;
+        uint32_t pos = entries[i].pathHash & mask;
+        while (slots[pos] != 0) {
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = i + 1;
+    }
+    /*实体头部中的ETag以内容哈希为inode，与AssetPack::Stat一致*/
+    std::vector<std::string> sorted;
+    for (const Asset &a : assets) {
+        sorted.push_back(a.path);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<std::string> headers(assets.size());
+    for (size_t i = 0; i < assets.size(); i++) {
+        const Asset &a = assets[i];
+        uint64_t hash = ContentHash(a.data);
+        unsigned long ino = hash != 0 ? hash : 1;
+        std::string direct = EntityHeaderBlock(a.path, ino, a.data.size(), a.mtime, Compressible(a.path), nullptr);
+        std::string base;
+        const char *encoding = VariantEncoding(a.path, sorted, base);
+        std::string variant = encoding ? EntityHeaderBlock(base, ino, a.data.size(), a.mtime, true, encoding) : "";
+        entries[i].contentHash = hash;
+        entries[i].headerOffset = offset;
+        entries[i].headerLen = direct.size();
+        entries[i].variantHeaderLen = variant.size();
+        headers[i] = direct + variant;
+        offset += headers[i].size();
+    }
+    for (size_t i = 0; i < assets.size(); i++) {
+        offset = Align(offset);
+        entries[i].dataOffset = offset;
+        entries[i].size = assets[i].data.size();
+        entries[i].mtimeSec = assets[i].mtime.tv_sec;
+        entries[i].mtimeNsec = assets[i].mtime.tv_nsec;
+        offset += assets[i].data.size();
+    }
+    header.fileSize = offset;
+
+    std::string tmp = file + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "wb");
+    if (!fp) {
+        fprintf(stderr, "open %s: %s\n", tmp.c_str(), strerror(errno));
+        return false;
+    }
+    size_t written = 0;
+    auto put = [&](const void *data, size_t len) {
+        fwrite(data, 1, len, fp);
+        written += len;
+    };
+    put(&header, sizeof(header));
+    put(entries.data(), entries.size() * sizeof(PackEntry));
+    put(slots.data(), slots.size() * sizeof(uint32_t));
+    for (const Asset &a : assets) {
+        put(a.path.data(), a.path.size());
+    }
+    for (const std::string &h : headers) {
+        put(h.data(), h.size());
+    }
+    const char zeros[PACK_ALIGN] = {0};
+    for (const Asset &a : assets) {
+        put(zeros, Align(written) - written);
+        put(a.data.data(), a.data.size());
+    }
+    bool ok = !ferror(fp) && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    fclose(fp);
+    if (!ok || written != header.fileSize || rename(tmp.c_str(), file.c_str()) < 0) {
+        fprintf(stderr, "write %s failed\n", file.c_str());
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <resources dir> <output file>\n", argv[0]);
+        return 1;
+    }
+    std::string root = argv[1];
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+    std::vector<Asset> assets;
+    if (!Collect(root, "", assets)) {
+        return 1;
+    }
+    size_t files = assets.size();
+    AddVariants(assets);
+    if (!Write(assets, argv[2])) {
+        return 1;
+    }
+    size_t bytes = 0;
+    for (const Asset &a : assets) {
+        bytes += a.data.size();
+    }
+    printf("packed %zu files and %zu compressed variants, %zu bytes of content, into %s\n", files,
+           assets.size() - files, bytes, argv[2]);
+    return 0;
+}